@@ -0,0 +1,94 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef BENCHMARK_UTILS_H_
+#define BENCHMARK_UTILS_H_
+
+#include <benchmark/benchmark.h>
+#include <flir_spinnaker_common/pixel_format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+namespace benchmark_utils
+{
+struct Resolution
+{
+  const char * name;
+  size_t width;
+  size_t height;
+};
+
+// typical sensor sizes: 1.3, 5 and 12 MP
+static const Resolution RESOLUTIONS[] = {
+  {"1.3MP", 1280, 1024}, {"5MP", 2448, 2048}, {"12MP", 4096, 3000}};
+
+inline std::vector<pixel_format::PixelFormat> all_formats()
+{
+  std::vector<pixel_format::PixelFormat> formats;
+  for (int i = pixel_format::INVALID + 1; i < pixel_format::NUM_PIXEL_FORMATS;
+       i++) {
+    formats.push_back(static_cast<pixel_format::PixelFormat>(i));
+  }
+  return (formats);
+}
+
+inline size_t get_stride(pixel_format::PixelFormat pf, size_t width)
+{
+  return ((width * pixel_format::get_traits(pf).bitsPerPixel + 7) / 8);
+}
+
+// random image content, the timing of the kernels does not depend on it
+inline std::vector<uint8_t> make_image(
+  pixel_format::PixelFormat pf, const Resolution & r)
+{
+  std::vector<uint8_t> img(get_stride(pf, r.width) * r.height);
+  std::mt19937 gen(42);
+  for (auto & v : img) {
+    v = static_cast<uint8_t>(gen());
+  }
+  return (img);
+}
+
+// registers fn for every pixel format and resolution that pred accepts,
+// as <name>/<format>/<resolution>
+template <class Pred, class Fn>
+inline void register_per_format(
+  const std::string & name, Pred pred, Fn fn, bool useRealTime = false)
+{
+  for (const auto pf : all_formats()) {
+    if (!pred(pf)) {
+      continue;
+    }
+    for (const auto & r : RESOLUTIONS) {
+      const std::string n =
+        name + "/" + pixel_format::to_string(pf) + "/" + r.name;
+      auto b = benchmark::RegisterBenchmark(n.c_str(), fn, pf, r);
+      b->Unit(benchmark::kMicrosecond);
+      if (useRealTime) {
+        b->UseRealTime();
+      }
+    }
+  }
+}
+}  // namespace benchmark_utils
+}  // namespace flir_spinnaker_common
+#endif  // BENCHMARK_UTILS_H_
@@ -0,0 +1,257 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <benchmark/benchmark.h>
+#include <flir_spinnaker_common/driver.h>
+#include <flir_spinnaker_common/image.h>
+#include <flir_spinnaker_common/pixel_format.h>
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "camera.h"
+#include "driver_impl.h"
+#include "memory_pool.h"
+#ifdef HAVE_SPINNAKER
+#include "genicam_utils.h"
+#include "system_wrapper.h"
+#endif
+
+namespace flir_spinnaker_common
+{
+using benchmark_utils::Resolution;
+using pixel_format::PixelFormat;
+
+// same block size as the driver's image pool
+static const size_t IMAGE_POOL_BLOCK_SIZE = sizeof(Image) + 128;
+
+#ifdef HAVE_SPINNAKER
+static const char * const NODE_PATHS[] = {
+  "AnalogControl/Gain", "AcquisitionControl/ExposureTime",
+  "ImageFormatControl/PixelFormat", "ImageFormatControl/Width"};
+static const size_t NUM_NODE_PATHS = sizeof(NODE_PATHS) / sizeof(NODE_PATHS[0]);
+#endif
+
+//
+// One started driver per pixel format. The synthetic camera runs at a
+// negligible rate, the benchmark feeds the frames to onFrame()
+// directly. The drivers are never destroyed, so the exit does not
+// wait for their threads.
+//
+static DriverImpl * get_driver(PixelFormat pf)
+{
+  static auto * drivers = new std::map<PixelFormat, DriverImpl *>();
+  DriverImpl *& d = (*drivers)[pf];
+  if (!d) {
+    Driver::SyntheticCameraConfig config;
+    config.pixelFormat = pixel_format::to_string(pf);
+    config.frameRate = 1e-3;
+    d = new DriverImpl();
+    d->setAcquisitionTimeout(1e6);
+    d->initSyntheticCamera(config);
+    d->setComputeBrightness(true);
+    d->startCamera([](const ImageConstPtr &) {}, Driver::DeliveryConfig());
+  }
+  return (d);
+}
+
+#ifdef HAVE_SPINNAKER
+// Camera for the node lookups, selected with the environment
+// variable FLIR_SPINNAKER_BENCHMARK_SERIAL.
+struct BenchmarkCamera
+{
+  BenchmarkCamera()
+  {
+    const char * serial = std::getenv("FLIR_SPINNAKER_BENCHMARK_SERIAL");
+    if (serial) {
+      system = SystemWrapper::getInstance();
+      system->refreshCameraList();
+      camera = system->findCamera(serial);
+      if (camera) {
+        camera->Init();
+      }
+    }
+  }
+  ~BenchmarkCamera()
+  {
+    if (camera) {
+      camera->DeInit();
+    }
+    camera = Spinnaker::CameraPtr();
+  }
+  std::shared_ptr<SystemWrapper> system;
+  Spinnaker::CameraPtr camera;
+};
+
+static Spinnaker::CameraPtr get_camera(benchmark::State & state)
+{
+  static BenchmarkCamera cam;
+  if (!cam.camera) {
+    state.SkipWithError("no camera, set FLIR_SPINNAKER_BENCHMARK_SERIAL");
+  }
+  return (cam.camera);
+}
+#endif
+
+// the whole per-frame path: statistics, brightness, image
+// construction from the pool and the synchronous callback
+static void on_frame(
+  benchmark::State & state, PixelFormat pf, const Resolution & r)
+{
+  DriverImpl * driver = get_driver(pf);
+  const std::vector<uint8_t> img = benchmark_utils::make_image(pf, r);
+  const pixel_format::Traits t = pixel_format::get_traits(pf);
+  CameraFrame f;
+  f.data = img.data();
+  f.imageSize = img.size();
+  f.width = r.width;
+  f.height = r.height;
+  f.stride = benchmark_utils::get_stride(pf, r.width);
+  f.bitsPerPixel = t.bitsPerPixel;
+  f.numChannels = t.numChannels;
+  for (auto _ : state) {
+    f.frameId++;
+    driver->onFrame(f);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static Image make_image_args()
+{
+  return (Image(
+    0, -1, 1000, 2000, 0, 0, 1280 * 1024, 0, nullptr, 1280, 1024, 1280, 8, 1,
+    0, pixel_format::Mono8));
+}
+
+static void BM_ImageMakeShared(benchmark::State & state)
+{
+  const Image proto = make_image_args();
+  for (auto _ : state) {
+    ImagePtr img = std::make_shared<Image>(proto);
+    benchmark::DoNotOptimize(img);
+  }
+}
+BENCHMARK(BM_ImageMakeShared);
+
+static void BM_ImageAllocateShared(benchmark::State & state)
+{
+  const Image proto = make_image_args();
+  auto pool = std::make_shared<MemoryPool>(IMAGE_POOL_BLOCK_SIZE, 64);
+  for (auto _ : state) {
+    ImagePtr img =
+      std::allocate_shared<Image>(PoolAllocator<Image>(pool), proto);
+    benchmark::DoNotOptimize(img);
+  }
+  state.counters["poolMisses"] = static_cast<double>(pool->getMisses());
+}
+BENCHMARK(BM_ImageAllocateShared);
+
+static void BM_PixelFormatFromString(benchmark::State & state)
+{
+  std::vector<std::string> names;
+  for (const auto pf : benchmark_utils::all_formats()) {
+    names.push_back(pixel_format::to_string(pf));
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      pixel_format::from_nodemap_string(names[i++ % names.size()]));
+  }
+}
+BENCHMARK(BM_PixelFormatFromString);
+
+static void BM_PixelFormatToString(benchmark::State & state)
+{
+  const auto formats = benchmark_utils::all_formats();
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      pixel_format::to_string(formats[i++ % formats.size()]));
+  }
+}
+BENCHMARK(BM_PixelFormatToString);
+
+// lookup with a format that is only known at run time
+static void BM_PixelFormatTraits(benchmark::State & state)
+{
+  const auto formats = benchmark_utils::all_formats();
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      pixel_format::get_traits(formats[i++ % formats.size()]));
+  }
+}
+BENCHMARK(BM_PixelFormatTraits);
+
+#ifdef HAVE_SPINNAKER
+// walks the category tree for every lookup
+static void BM_FindNode(benchmark::State & state)
+{
+  Spinnaker::CameraPtr cam = get_camera(state);
+  if (!cam) {
+    return;
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(genicam_utils::find_node(
+      NODE_PATHS[i++ % NUM_NODE_PATHS], cam, false));
+  }
+}
+BENCHMARK(BM_FindNode);
+
+static void BM_NodeCacheBuild(benchmark::State & state)
+{
+  Spinnaker::CameraPtr cam = get_camera(state);
+  if (!cam) {
+    return;
+  }
+  for (auto _ : state) {
+    genicam_utils::NodeCache cache;
+    cache.build(cam, false);
+    benchmark::DoNotOptimize(cache.size());
+  }
+  state.SetLabel("once per initCamera()");
+}
+BENCHMARK(BM_NodeCacheBuild)->Unit(benchmark::kMillisecond);
+
+static void BM_NodeCacheFind(benchmark::State & state)
+{
+  Spinnaker::CameraPtr cam = get_camera(state);
+  if (!cam) {
+    return;
+  }
+  genicam_utils::NodeCache cache;
+  cache.build(cam, false);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cache.find(NODE_PATHS[i++ % NUM_NODE_PATHS]));
+  }
+}
+BENCHMARK(BM_NodeCacheFind);
+#endif
+
+static int register_benchmarks()
+{
+  benchmark_utils::register_per_format(
+    "BM_OnFrame", [](PixelFormat) { return (true); }, on_frame);
+  return (0);
+}
+static const int registered = register_benchmarks();
+}  // namespace flir_spinnaker_common
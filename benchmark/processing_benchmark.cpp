@@ -0,0 +1,100 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <benchmark/benchmark.h>
+#include <flir_spinnaker_common/debayer.h>
+#include <flir_spinnaker_common/pixel_format.h>
+#include <flir_spinnaker_common/unpack.h>
+
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "brightness.h"
+
+namespace flir_spinnaker_common
+{
+using benchmark_utils::Resolution;
+using pixel_format::PixelFormat;
+
+template <int skip>
+static void compute_brightness(
+  benchmark::State & state, PixelFormat pf, const Resolution & r)
+{
+  const std::vector<uint8_t> img = benchmark_utils::make_image(pf, r);
+  const size_t stride = benchmark_utils::get_stride(pf, r.width);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(brightness::compute_brightness(
+      pf, img.data(), r.width, r.height, stride, skip));
+  }
+  state.SetLabel(brightness::get_instruction_set());
+}
+
+template <int numThreads>
+static void unpack_image(
+  benchmark::State & state, PixelFormat pf, const Resolution & r)
+{
+  const std::vector<uint8_t> img = benchmark_utils::make_image(pf, r);
+  const size_t stride = benchmark_utils::get_stride(pf, r.width);
+  std::vector<uint16_t> dst(r.width * r.height);
+  for (auto _ : state) {
+    unpack::unpack(
+      pf, img.data(), r.width, r.height, stride, dst.data(),
+      r.width * sizeof(uint16_t), numThreads);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * img.size());
+  state.SetLabel(unpack::get_instruction_set());
+}
+
+template <debayer::Method method, int numThreads>
+static void debayer_image(
+  benchmark::State & state, PixelFormat pf, const Resolution & r)
+{
+  const std::vector<uint8_t> img = benchmark_utils::make_image(pf, r);
+  const size_t stride = benchmark_utils::get_stride(pf, r.width);
+  std::vector<uint8_t> dst(r.width * r.height * 3);
+  for (auto _ : state) {
+    debayer::debayer(
+      pf, img.data(), r.width, r.height, stride, dst.data(), r.width * 3,
+      debayer::RGB8, method, numThreads);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * r.width * r.height);
+}
+
+static int register_benchmarks()
+{
+  using benchmark_utils::register_per_format;
+  const auto all = [](PixelFormat) { return (true); };
+  // skip 32 is the driver default
+  register_per_format("BM_ComputeBrightness", all, compute_brightness<32>);
+  register_per_format("BM_ComputeBrightnessFull", all, compute_brightness<1>);
+  register_per_format("BM_Unpack", unpack::is_packed, unpack_image<1>);
+  register_per_format(
+    "BM_UnpackAllThreads", unpack::is_packed, unpack_image<0>);
+  register_per_format(
+    "BM_DebayerBilinear", debayer::is_supported,
+    debayer_image<debayer::BILINEAR, 1>);
+  register_per_format(
+    "BM_DebayerEdgeAware", debayer::is_supported,
+    debayer_image<debayer::EDGE_AWARE, 1>);
+  register_per_format(
+    "BM_DebayerEdgeAwareAllThreads", debayer::is_supported,
+    debayer_image<debayer::EDGE_AWARE, 0>);
+  return (0);
+}
+static const int registered = register_benchmarks();
+}  // namespace flir_spinnaker_common
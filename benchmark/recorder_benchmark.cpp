@@ -0,0 +1,126 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <benchmark/benchmark.h>
+#include <flir_spinnaker_common/image.h>
+#include <flir_spinnaker_common/recorder.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_utils.h"
+
+namespace flir_spinnaker_common
+{
+using benchmark_utils::Resolution;
+
+static const int FRAMES_PER_ITERATION = 32;
+static const char * const BASE_NAME = "flir_spinnaker_benchmark";
+
+// the files go to FLIR_SPINNAKER_BENCHMARK_DIR, default /tmp
+static std::string get_directory()
+{
+  const char * dir = std::getenv("FLIR_SPINNAKER_BENCHMARK_DIR");
+  return (dir ? dir : "/tmp");
+}
+
+static void remove_files(const std::string & dir, int numWriters)
+{
+  for (int w = 0; w < numWriters; w++) {
+    for (int c = 0;; c++) {
+      const std::string name = dir + "/" + BASE_NAME + "_" +
+                               std::to_string(w) + "_" + std::to_string(c) +
+                               ".raw";
+      if (std::remove(name.c_str()) != 0) {
+        break;
+      }
+    }
+  }
+  std::remove((dir + "/" + BASE_NAME + ".idx").c_str());
+}
+
+//
+// Sustained write rate to disk. Frames are offered only as fast as the
+// writers take them, so none are dropped and the rate is the one the
+// recorder can keep up indefinitely.
+//
+template <int numWriters>
+static void recorder_throughput(
+  benchmark::State & state, pixel_format::PixelFormat pf, const Resolution & r)
+{
+  const std::string dir = get_directory();
+  auto data = std::make_shared<std::vector<uint8_t>>(
+    benchmark_utils::make_image(pf, r));
+  const size_t stride = benchmark_utils::get_stride(pf, r.width);
+  const pixel_format::Traits t = pixel_format::get_traits(pf);
+  uint64_t bytesWritten = 0;
+  uint64_t numDropped = 0;
+  uint64_t frameId = 0;
+  for (auto _ : state) {
+    Recorder::Config config;
+    config.directory = dir;
+    config.baseName = BASE_NAME;
+    config.numWriterThreads = numWriters;
+    config.chunkSize = size_t(1) << 28;
+    Recorder recorder(config);
+    if (!recorder.open()) {
+      state.SkipWithError(("cannot write to " + dir).c_str());
+      break;
+    }
+    for (int i = 0; i < FRAMES_PER_ITERATION; i++) {
+      while (recorder.getStatistics().queueDepth + 1 >= config.queueSize) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+      // the holder keeps the data alive, so the recorder does not copy
+      recorder.write(std::make_shared<Image>(
+        0, -1, 1000, 2000, 0, 0, data->size(), 0, data->data(), r.width,
+        r.height, stride, t.bitsPerPixel, t.numChannels, frameId++, pf,
+        data));
+    }
+    recorder.close();
+    const Recorder::Statistics s = recorder.getStatistics();
+    bytesWritten += s.bytesWritten;
+    numDropped += s.numDropped;
+    state.PauseTiming();
+    remove_files(dir, numWriters);
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(bytesWritten));
+  state.counters["numDropped"] = static_cast<double>(numDropped);
+}
+
+static int register_benchmarks()
+{
+  using benchmark_utils::register_per_format;
+  const auto bayer8 = [](pixel_format::PixelFormat pf) {
+    return (pf == pixel_format::BayerRG8);
+  };
+  // the work happens on the writer threads
+  register_per_format(
+    "BM_RecorderThroughput", bayer8, recorder_throughput<1>, true);
+  register_per_format(
+    "BM_RecorderThroughput2Writers", bayer8, recorder_throughput<2>, true);
+  register_per_format(
+    "BM_RecorderThroughput4Writers", bayer8, recorder_throughput<4>, true);
+  return (0);
+}
+static const int registered = register_benchmarks();
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,58 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLIR_SPINNAKER_COMMON__DEBAYER_H_
+#define FLIR_SPINNAKER_COMMON__DEBAYER_H_
+
+#include <flir_spinnaker_common/image.h>
+#include <flir_spinnaker_common/pixel_format.h>
+
+#include <cstddef>
+
+namespace flir_spinnaker_common
+{
+namespace debayer
+{
+enum Method {
+  BILINEAR,
+  // interpolates green along the direction of the smaller gradient,
+  // red and blue from the color differences to green
+  EDGE_AWARE
+};
+enum OutputFormat { RGB8, BGR8, RGB16 };
+//
+// Converts BayerRG/GR/GB/BG 8 and 16 bit, and the packed BayerRG 10/12
+// bit formats, to color. The image is processed in bands of rows that
+// fit into the cache, and the bands are spread across the processing
+// threads (numThreads = 0: all cores). dstStride is in bytes.
+// Returns false if the pixel format is not supported.
+//
+bool debayer(
+  pixel_format::PixelFormat pf, const void * src, size_t w, size_t h,
+  size_t srcStride, void * dst, size_t dstStride, OutputFormat outFmt,
+  Method method, int numThreads = 0);
+bool debayer(
+  const Image & img, void * dst, size_t dstStride, OutputFormat outFmt,
+  Method method, int numThreads = 0);
+// true if the pixel format can be debayered
+bool is_supported(pixel_format::PixelFormat pf);
+// name of the instruction set used: "avx2", "sse2", "neon" or "scalar"
+const char * get_instruction_set();
+// Overrides the instruction set picked at startup, e.g. to test all
+// code paths. Returns false if the CPU does not support it.
+bool set_instruction_set(const char * name);
+}  // namespace debayer
+}  // namespace flir_spinnaker_common
+#endif  // FLIR_SPINNAKER_COMMON__DEBAYER_H_
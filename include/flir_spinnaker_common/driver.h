@@ -38,18 +38,268 @@ public:
     const std::string what_;
   };
   typedef std::function<void(const ImageConstPtr & img)> Callback;
+  // SYNCHRONOUS runs the callback on the Spinnaker event thread,
+  // ASYNCHRONOUS queues the images and runs the callback on
+  // numThreads dedicated worker threads.
+  enum DeliveryMode { SYNCHRONOUS, ASYNCHRONOUS };
+  // what to do when the delivery queue is full
+  enum OverflowPolicy { DROP_OLDEST, DROP_NEWEST, BLOCK };
+  struct DeliveryConfig
+  {
+    DeliveryMode mode{SYNCHRONOUS};
+    OverflowPolicy overflowPolicy{DROP_OLDEST};
+    size_t queueSize{4};
+    int numThreads{1};
+  };
+  // How the transport layer buffers frames between the camera and the
+  // driver. DEFAULT_STREAMING leaves the SDK settings alone.
+  // LOW_LATENCY (NewestOnly) always delivers the most recent frame and
+  // discards older ones if the consumer falls behind, using few buffers.
+  // HIGH_THROUGHPUT (OldestFirst) delivers every frame in order, with
+  // enough buffers to absorb bufferTime seconds of consumer delay at the
+  // current frame rate, up to maxBufferMemory bytes.
+  enum StreamingProfile { DEFAULT_STREAMING, LOW_LATENCY, HIGH_THROUGHPUT };
+  struct StreamingConfig
+  {
+    StreamingProfile profile{DEFAULT_STREAMING};
+    double bufferTime{1.0};  // sec
+    size_t maxBufferMemory{1024 * 1024 * 1024};
+  };
+  // EVENT_THREAD: frames arrive on the SDK's event thread, whose
+  // priority and placement the driver does not control.
+  // POLLING_THREAD: the driver fetches the frames on its own thread,
+  // which can be pinned to cpus, run at SCHED_FIFO priority (1..99,
+  // 0: normal scheduling), and lock the process memory against paging.
+  enum AcquisitionThreadMode { EVENT_THREAD, POLLING_THREAD };
+  struct AcquisitionThreadConfig
+  {
+    AcquisitionThreadMode mode{EVENT_THREAD};
+    std::vector<int> cpus;  // empty: any cpu
+    int priority{0};
+    bool lockMemory{false};
+  };
+  // Acquisition statistics since the camera was started. Times are in
+  // seconds, interval percentiles are accurate to about 20%.
+  struct Statistics
+  {
+    uint64_t numFrames{0};
+    uint64_t numIncomplete{0};
+    double instantaneousFrameRate{0};  // from the last frame interval
+    double receiveFrameRate{0};  // averaged over the last 64 frames
+    double intervalP50{0};  // inter-frame interval
+    double intervalP99{0};
+    double intervalMax{0};
+    double intervalStdDev{0};  // jitter
+    double callbackTimeAvg{0};  // time spent in the user callback
+    double callbackTimeMax{0};
+    uint64_t poolHits{0};  // see getImagePoolStatistics()
+    uint64_t poolMisses{0};
+    size_t queueDepth{0};  // see getDeliveryQueueStatistics()
+    uint64_t numDropped{0};
+    // Acquisition restarts by the watchdog. The recovery time runs
+    // from the detection of a stall to the first frame after it.
+    uint64_t numRestarts{0};
+    uint64_t numRecoveries{0};
+    double lastRecoveryTime{0};
+    double maxRecoveryTime{0};
+    // Time spent in the stream buffers, from the camera time stamps,
+    // relative to the fastest recent frame
+    double bufferLatencyAvg{0};
+    double bufferLatencyMax{0};
+    // from the arrival of a frame to the end of its callback
+    double deliveryLatencyAvg{0};
+    double deliveryLatencyMax{0};
+    int64_t numStreamBuffers{0};
+    double clockDrift{0};  // ppm, of the camera clock against the host's
+  };
+  // Where frames got lost since the camera was started. The stream
+  // counters come from the transport layer and are -1 if the camera
+  // does not provide them.
+  struct FrameDropStatistics
+  {
+    // from discontinuities of the frame id of received images
+    uint64_t numFramesReceived{0};
+    uint64_t numFrameIdGaps{0};
+    uint64_t numFramesMissing{0};  // sum of all gap sizes
+    // incomplete images delivered by the stream
+    uint64_t numIncomplete{0};
+    // dropped by the driver because the consumers were too slow
+    uint64_t numDroppedByConsumer{0};
+    // transport layer stream counters, frames discarded by the
+    // LOW_LATENCY profile count as dropped
+    int64_t streamLostFrameCount{-1};
+    int64_t streamDroppedFrameCount{-1};
+    int64_t streamBufferUnderrunCount{-1};
+    int64_t streamIncompleteFrameCount{-1};
+    int64_t streamResendRequestCount{-1};
+  };
+  // Software auto exposure, driven by the per-frame brightness.
+  // Exposure time is raised up to maxExposureTime before any gain
+  // is added, and gain is removed before exposure time is lowered.
+  struct ExposureControlConfig
+  {
+    bool enabled{false};
+    double targetBrightness{128};  // 0..255, see Image::brightness_
+    double tolerance{4};  // no correction within target +- tolerance
+    // 0: apply the full correction at once, towards 1: smaller steps
+    double damping{0.3};
+    double minExposureTime{20};  // usec
+    double maxExposureTime{0};  // usec, 0: the camera's limit
+    double minGain{0};  // dB
+    double maxGain{18};  // dB
+    double maxUpdateRate{20};  // maximum rate of camera writes (Hz)
+  };
+  // Camera simulated in software, for running the driver without
+  // hardware. Frames show a horizontal gradient whose level follows
+  // ExposureTime and Gain, at the rate of AcquisitionFrameRate.
+  // Faults are injected periodically, 0 disables them.
+  struct SyntheticCameraConfig
+  {
+    std::string serialNumber{"synthetic"};
+    std::string pixelFormat{"BayerRG8"};  // any known pixel format
+    size_t width{640};  // sensor size, the maximum ROI
+    size_t height{480};
+    double frameRate{30};  // Hz, 0: as fast as possible
+    // mean brightness (0..255) per usec of exposure at 0dB gain
+    double sceneBrightness{0.02};
+    int numStreamBuffers{10};
+    uint64_t incompleteEvery{0};  // every n'th frame is incomplete
+    uint64_t frameIdGapEvery{0};  // skip frame ids every n frames ...
+    uint64_t frameIdGapSize{1};  // ... this many of them
+    uint64_t stallEvery{0};  // pause the stream every n frames ...
+    double stallDuration{1.0};  // ... for this many seconds
+    double clockDrift{0};  // ppm, of the camera clock
+    // maximum random delay (sec) between time stamp and delivery
+    double deliveryJitter{0};
+  };
+  // Keeps the parameters applied to each camera in a file in
+  // directory (which must exist), named after serial number and
+  // firmware version, along with the node map description. The set*()
+  // methods skip parameters that were applied before with the same
+  // value, and return the value read back then. With useUserSet, the
+  // settings are also saved to the camera's UserSet1, which becomes
+  // its power on default, and the cache is trusted as it is. Without,
+  // every skipped value is checked by reading it from the camera.
+  struct ConfigCacheConfig
+  {
+    std::string directory;  // empty: no cache
+    bool useUserSet{false};
+  };
+  // Hot plug events. ARRIVED and REMOVED are reported for any camera
+  // in the system. The others concern the camera of this driver, when
+  // it came back after a removal.
+  enum DeviceEvent {
+    DEVICE_ARRIVED,
+    DEVICE_REMOVED,
+    DEVICE_RECONNECTED,
+    DEVICE_RECONNECT_FAILED
+  };
+  typedef std::function<void(
+    const std::string & serialNumber, DeviceEvent event)>
+    DeviceCallback;
+  // region of interest on the sensor, in pixels
+  struct Roi
+  {
+    size_t offsetX{0};
+    size_t offsetY{0};
+    size_t width{0};
+    size_t height{0};
+  };
+  // a typed write of a single node, for setParameters()
+  enum ParameterType { ENUM, DOUBLE, INT, BOOL };
+  struct Parameter
+  {
+    Parameter() = default;
+    Parameter(const std::string & n, const std::string & v)
+    : name(n), type(ENUM), enumValue(v)
+    {
+    }
+    Parameter(const std::string & n, const char * v)
+    : name(n), type(ENUM), enumValue(v)
+    {
+    }
+    Parameter(const std::string & n, double v)
+    : name(n), type(DOUBLE), doubleValue(v)
+    {
+    }
+    Parameter(const std::string & n, int v) : name(n), type(INT), intValue(v)
+    {
+    }
+    Parameter(const std::string & n, bool v)
+    : name(n), type(BOOL), boolValue(v)
+    {
+    }
+    std::string name;  // node path or bare node name
+    ParameterType type{ENUM};
+    std::string enumValue;
+    double doubleValue{0};
+    int intValue{0};
+    bool boolValue{false};
+  };
+  struct ParameterResult
+  {
+    bool ok{false};
+    std::string message;  // "OK" or the reason for the failure
+    Parameter value;  // value read back from the camera
+  };
   Driver();
   std::string getLibraryVersion() const;
   void refreshCameraList();
   std::vector<std::string> getSerialNumbers() const;
 
   bool initCamera(const std::string & serialNumber);
+  // use a simulated camera instead of one found by the SDK
+  bool initSyntheticCamera(const SyntheticCameraConfig & config);
   bool deInitCamera();
   bool startCamera(const Driver::Callback & cb);
+  bool startCamera(const Driver::Callback & cb, const DeliveryConfig & dc);
   bool stopCamera();
   void setDebug(bool b);
   void setComputeBrightness(bool b);
+  // brightness is computed from every skip'th row (default: 32)
+  void setBrightnessSkip(int skip);
+  // The acquisition is restarted when no frame arrives for a few
+  // frame intervals, or at the latest after this time (default: 10s).
   void setAcquisitionTimeout(double sec);
+  // Takes effect at the next startCamera(). Switches off the camera's
+  // ExposureAuto and GainAuto, and enables brightness computation.
+  void setExposureControl(const ExposureControlConfig & config);
+  // With zero copy enabled, the images passed to the callback keep the
+  // Spinnaker buffer alive and can be used after the callback returns.
+  // If more than maxHeldBuffers are in use, the data is copied instead.
+  // A Recorder holds up to its queueSize + numWriterThreads of them.
+  // Both must be set before startCamera().
+  void setZeroCopy(bool b);
+  void setMaxHeldBuffers(int n);
+  // Takes effect at the next startCamera(). Buffers held by zero copy
+  // and asynchronous delivery are added to the ones of the profile.
+  void setStreamingConfig(const StreamingConfig & config);
+  // takes effect at the next startCamera()
+  void setAcquisitionThreadConfig(const AcquisitionThreadConfig & config);
+  // Called on a driver thread, one event at a time. The callback may
+  // use the driver, but must not destroy it.
+  void setDeviceCallback(const DeviceCallback & cb);
+  // When the camera of this driver is removed, it is deinitialized.
+  // With auto reconnect (default: on), it is initialized again when it
+  // comes back, the parameters applied before are restored, and it is
+  // restarted with the same callback if it was running. Applying the
+  // parameters is fast with a config cache and user set, see
+  // setConfigCache().
+  void setAutoReconnect(bool b);
+  // Takes effect at the next initCamera(). The cache is saved by
+  // startCamera() and deInitCamera(), or explicitly.
+  void setConfigCache(const ConfigCacheConfig & config);
+  bool saveConfigCache();
+  // number of per-frame allocations served from the image pool (hits)
+  // or from the heap (misses) since the camera was started
+  void getImagePoolStatistics(uint64_t * hits, uint64_t * misses) const;
+  // current number of queued images and number of images dropped
+  // due to overflow (asynchronous delivery only)
+  void getDeliveryQueueStatistics(size_t * depth, uint64_t * dropped) const;
+
+  // cheap enough to be polled at high rate, does not lock
+  Statistics getStatistics() const;
+  FrameDropStatistics getFrameDropStatistics() const;
 
   std::string getPixelFormat() const;
   double getReceiveFrameRate() const;
@@ -61,6 +311,22 @@ public:
     const std::string & nodeName, double val, double * retVal);
   std::string setBool(const std::string & nodeName, bool val, bool * retVal);
   std::string setInt(const std::string & nodeName, int val, int * retVal);
+  // Writes a batch of parameters in dependency order (e.g. PixelFormat
+  // before Width, ExposureAuto before ExposureTime), otherwise in the
+  // given order. If some of them cannot be written while streaming,
+  // acquisition is stopped and restarted once for the whole batch.
+  // Returns one result per parameter, in the order given.
+  std::vector<ParameterResult> setParameters(
+    const std::vector<Parameter> & params);
+  // Moves or resizes the region of interest. The values are rounded
+  // down to the camera's increments and checked against the sensor
+  // size before anything is written. Moves happen while streaming. A
+  // size change restarts only the stream, keeping the driver's buffers,
+  // queues and threads. Returns "OK" or the reason for the failure,
+  // and the region of interest in effect. Every Image carries the
+  // offsets it was taken with.
+  std::string setRoi(const Roi & roi, Roi * actual = nullptr);
+  bool getRoi(Roi * roi);
 
 private:
   // ----- variables --
@@ -29,7 +29,8 @@ public:
     uint64_t t, int16_t brightness, uint32_t et, uint32_t maxEt, float gain,
     int64_t imgT, size_t imageSize, int status, const void * data, size_t w,
     size_t h, size_t stride, size_t bitsPerPixel, size_t numChan,
-    uint64_t frameId, pixel_format::PixelFormat pixFmt);
+    uint64_t frameId, pixel_format::PixelFormat pixFmt,
+    const std::shared_ptr<void> & bufferHolder = std::shared_ptr<void>());
 
   // ----- variables --
   uint64_t time_;
@@ -37,17 +38,28 @@ public:
   uint32_t exposureTime_;
   uint32_t maxExposureTime_;
   float gain_;
-  int64_t imageTime_;
+  int64_t imageTime_;  // camera time stamp
+  // the camera time stamp mapped into host time (nsec), without the
+  // delivery jitter of time_. 0 if not known.
+  uint64_t correctedTime_{0};
   size_t imageSize_;
   int imageStatus_;
   const void * data_;
   size_t width_;
   size_t height_;
   size_t stride_;  // in bytes
+  // position of the region of interest on the sensor
+  size_t offsetX_{0};
+  size_t offsetY_{0};
   size_t bitsPerPixel_;
   size_t numChan_;
   uint64_t frameId_;
   pixel_format::PixelFormat pixelFormat_;
+  // If set, keeps the memory that data_ points to alive for as long
+  // as the image exists. Its deleter is the hook that hands the buffer
+  // back to its owner (e.g. the Spinnaker stream). If not set, data_
+  // is only valid for the duration of the driver callback.
+  std::shared_ptr<void> bufferHolder_;
 
 private:
 };
@@ -0,0 +1,91 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLIR_SPINNAKER_COMMON__MULTI_DRIVER_H_
+#define FLIR_SPINNAKER_COMMON__MULTI_DRIVER_H_
+
+#include <flir_spinnaker_common/driver.h>
+#include <flir_spinnaker_common/image.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+class SystemWrapper;
+//
+// Runs several cameras off a single Spinnaker System instance and a
+// single enumeration of the cameras. Every camera gets its own Driver,
+// which can be used to set camera parameters.
+//
+class MultiDriver
+{
+public:
+  typedef std::function<void(
+    const std::string & serialNumber, const ImageConstPtr & img)>
+    Callback;
+  struct CameraStatistics : public Driver::Statistics
+  {
+    std::string serialNumber;
+  };
+  struct InitResult
+  {
+    std::string serialNumber;
+    bool ok{false};
+    std::string message;  // "OK" or the reason for the failure
+    double initTime{0};  // sec
+  };
+  MultiDriver();
+  ~MultiDriver();
+  std::string getLibraryVersion() const;
+  void refreshCameraList();
+  std::vector<std::string> getSerialNumbers() const;
+
+  // returns false if any of the cameras could not be initialized
+  bool initCameras(const std::vector<std::string> & serialNumbers);
+  // Initializes the cameras concurrently, on up to maxParallel threads
+  // (0: one per camera). Cameras missing from the camera list trigger
+  // one refresh of the list beforehand. Returns one result per serial
+  // number, in the order given.
+  std::vector<InitResult> initCameras(
+    const std::vector<std::string> & serialNumbers, int maxParallel);
+  void deInitCameras();
+  // by default, every camera delivers on its own worker thread
+  bool startCameras(const Callback & cb);
+  bool startCameras(const Callback & cb, const Driver::DeliveryConfig & dc);
+  bool stopCameras();
+  // Arrival and removal of any camera, and the reconnects of the
+  // cameras of this object (see Driver::setDeviceCallback()). Applies
+  // to the cameras initialized afterwards.
+  void setDeviceCallback(const Driver::DeviceCallback & cb);
+  // applies to the cameras initialized afterwards
+  void setConfigCache(const Driver::ConfigCacheConfig & config);
+  // returns null pointer if camera has not been initialized
+  std::shared_ptr<Driver> getDriver(const std::string & serialNumber) const;
+  std::vector<CameraStatistics> getStatistics() const;
+
+private:
+  // ----- variables --
+  std::shared_ptr<SystemWrapper> system_;
+  std::map<std::string, std::shared_ptr<Driver>> drivers_;
+  Driver::DeviceCallback deviceCallback_;
+  int deviceCallbackId_{-1};
+  Driver::ConfigCacheConfig configCacheConfig_;
+};
+}  // namespace flir_spinnaker_common
+#endif  // FLIR_SPINNAKER_COMMON__MULTI_DRIVER_H_
@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace flir_spinnaker_common
 {
@@ -54,6 +55,155 @@ enum PixelFormat {
   BGR8,
   BGRa8
 };
+static constexpr int NUM_PIXEL_FORMATS = BGRa8 + 1;
+
+enum Packing {
+  UNPACKED,  // every sample occupies 1 or 2 full bytes
+  PACKED_LSB,  // "p" formats: contiguous bit stream, LSB first
+  PACKED_GIGE  // GigE Vision "Packed": 2 pixels in 3 bytes
+};
+enum ColorFilter { NO_CFA, CFA_RG, CFA_GR, CFA_GB, CFA_BG };
+enum ChannelLayout {
+  LAYOUT_NONE,
+  LAYOUT_MONO,  // also used for Bayer formats
+  LAYOUT_RGB,
+  LAYOUT_BGR,
+  LAYOUT_BGRA,
+  LAYOUT_UYYVYY,  // YUV411Packed
+  LAYOUT_UYVY,  // YUV422Packed
+  LAYOUT_UYV,  // YUV444Packed
+  LAYOUT_YCBCR,  // YCbCr8
+  LAYOUT_YCBYCR,  // YCbCr422_8
+  LAYOUT_YYCBYYCR  // YCbCr411_8
+};
+
+struct Traits
+{
+  int bitsPerPixel;  // storage per pixel, including all channels
+  int bitDepth;  // significant bits per sample
+  int numChannels;
+  Packing packing;
+  ColorFilter cfa;
+  ChannelLayout layout;
+};
+
+//
+// Compile time description of a pixel format. Use with a constant
+// argument (or inside a kernel instantiated by dispatch()) so the
+// lookup is folded away.
+//
+constexpr Traits get_traits(PixelFormat f)
+{
+  switch (f) {
+    case Mono8:
+      return {8, 8, 1, UNPACKED, NO_CFA, LAYOUT_MONO};
+    case Mono10p:
+      return {10, 10, 1, PACKED_LSB, NO_CFA, LAYOUT_MONO};
+    case Mono10Packed:
+      return {12, 10, 1, PACKED_GIGE, NO_CFA, LAYOUT_MONO};
+    case Mono12p:
+      return {12, 12, 1, PACKED_LSB, NO_CFA, LAYOUT_MONO};
+    case Mono12Packed:
+      return {12, 12, 1, PACKED_GIGE, NO_CFA, LAYOUT_MONO};
+    case Mono16:
+      return {16, 16, 1, UNPACKED, NO_CFA, LAYOUT_MONO};
+    case RGB8:
+    case RGB8Packed:
+      return {24, 8, 3, UNPACKED, NO_CFA, LAYOUT_RGB};
+    case BayerRG8:
+      return {8, 8, 1, UNPACKED, CFA_RG, LAYOUT_MONO};
+    case BayerRG10p:
+      return {10, 10, 1, PACKED_LSB, CFA_RG, LAYOUT_MONO};
+    case BayerRG10Packed:
+      return {12, 10, 1, PACKED_GIGE, CFA_RG, LAYOUT_MONO};
+    case BayerRG12p:
+      return {12, 12, 1, PACKED_LSB, CFA_RG, LAYOUT_MONO};
+    case BayerRG12Packed:
+      return {12, 12, 1, PACKED_GIGE, CFA_RG, LAYOUT_MONO};
+    case BayerRG16:
+      return {16, 16, 1, UNPACKED, CFA_RG, LAYOUT_MONO};
+    case BayerGR8:
+      return {8, 8, 1, UNPACKED, CFA_GR, LAYOUT_MONO};
+    case BayerGR16:
+      return {16, 16, 1, UNPACKED, CFA_GR, LAYOUT_MONO};
+    case BayerGB8:
+      return {8, 8, 1, UNPACKED, CFA_GB, LAYOUT_MONO};
+    case BayerGB16:
+      return {16, 16, 1, UNPACKED, CFA_GB, LAYOUT_MONO};
+    case BayerBG8:
+      return {8, 8, 1, UNPACKED, CFA_BG, LAYOUT_MONO};
+    case BayerBG16:
+      return {16, 16, 1, UNPACKED, CFA_BG, LAYOUT_MONO};
+    case YUV411Packed:
+      return {12, 8, 3, UNPACKED, NO_CFA, LAYOUT_UYYVYY};
+    case YUV422Packed:
+      return {16, 8, 3, UNPACKED, NO_CFA, LAYOUT_UYVY};
+    case YUV444Packed:
+      return {24, 8, 3, UNPACKED, NO_CFA, LAYOUT_UYV};
+    case YCbCr8:
+      return {24, 8, 3, UNPACKED, NO_CFA, LAYOUT_YCBCR};
+    case YCbCr422_8:
+      return {16, 8, 3, UNPACKED, NO_CFA, LAYOUT_YCBYCR};
+    case YCbCr411_8:
+      return {12, 8, 3, UNPACKED, NO_CFA, LAYOUT_YYCBYYCR};
+    case BGR8:
+      return {24, 8, 3, UNPACKED, NO_CFA, LAYOUT_BGR};
+    case BGRa8:
+      return {32, 8, 4, UNPACKED, NO_CFA, LAYOUT_BGRA};
+    default:
+      return {0, 0, 0, UNPACKED, NO_CFA, LAYOUT_NONE};
+  }
+}
+
+//
+// Calls Kernel<f>::run(args...), where Kernel is a class template
+// parameterized on the pixel format. The switch is evaluated once per
+// call, so Kernel<F>::run() sees the format as a compile time constant
+// and its inner loops are free of format checks. Every format,
+// including INVALID, must compile.
+//
+template <template <PixelFormat> class Kernel, class... Args>
+auto dispatch(PixelFormat f, Args &&... args)
+  -> decltype(Kernel<INVALID>::run(std::forward<Args>(args)...))
+{
+#define FLIR_SPINNAKER_COMMON_DISPATCH_CASE(F) \
+  case F:                                      \
+    return (Kernel<F>::run(std::forward<Args>(args)...))
+  switch (f) {
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono10p);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono10Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono12p);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono12Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(Mono16);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(RGB8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(RGB8Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG10p);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG10Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG12p);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG12Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerRG16);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerGR8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerGR16);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerGB8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerGB16);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerBG8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BayerBG16);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YUV411Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YUV422Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YUV444Packed);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YCbCr8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YCbCr422_8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(YCbCr411_8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BGR8);
+    FLIR_SPINNAKER_COMMON_DISPATCH_CASE(BGRa8);
+    default:
+      return (Kernel<INVALID>::run(std::forward<Args>(args)...));
+  }
+#undef FLIR_SPINNAKER_COMMON_DISPATCH_CASE
+}
+
 std::string to_string(PixelFormat f);
 PixelFormat from_nodemap_string(const std::string pixFmt);
 }  // namespace pixel_format
@@ -0,0 +1,92 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLIR_SPINNAKER_COMMON__PLAYER_H_
+#define FLIR_SPINNAKER_COMMON__PLAYER_H_
+
+#include <flir_spinnaker_common/driver.h>
+#include <flir_spinnaker_common/image.h>
+#include <flir_spinnaker_common/recorder.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+class BufferPool;
+class DeliveryQueue;
+//
+// Plays back frames written by the Recorder as a virtual camera. The
+// images are delivered through a Driver::Callback, with the same
+// contract as Driver::startCamera(): the callback runs on the playback
+// thread (SYNCHRONOUS) or on delivery worker threads (ASYNCHRONOUS).
+// Images always own their data, so they can be kept after the
+// callback returns.
+//
+class Player
+{
+public:
+  enum Pacing {
+    ORIGINAL,  // reproduce the recorded host time stamps
+    FIXED_RATE,  // deliver at frameRate
+    MAX_RATE  // as fast as the consumers take them
+  };
+  struct Config
+  {
+    std::string directory{"."};
+    std::string baseName{"frames"};
+    Pacing pacing{ORIGINAL};
+    double frameRate{10};  // only for FIXED_RATE
+    bool loop{false};  // start over at the end
+    // stamp images with the current time instead of the recorded one
+    bool restamp{true};
+  };
+  explicit Player(const Config & config);
+  ~Player();
+  // reads the index, returns false if it cannot be found or is corrupt
+  bool open();
+  size_t getNumFrames() const { return (index_.size()); }
+  bool start(const Driver::Callback & cb);
+  bool start(const Driver::Callback & cb, const Driver::DeliveryConfig & dc);
+  void stop();
+  // true while frames are being played back
+  bool isRunning() const { return (running_); }
+  uint64_t getNumDelivered() const { return (numDelivered_); }
+  // frames the consumer could not keep up with (ASYNCHRONOUS only)
+  uint64_t getNumDropped() const;
+
+private:
+  void run();
+  ImageConstPtr readFrame(const Recorder::IndexEntry & e);
+  void closeFiles();
+  // ----- variables --
+  Config config_;
+  std::vector<Recorder::IndexEntry> index_;  // sorted by time
+  std::map<std::pair<uint32_t, uint32_t>, int> files_;  // chunk -> fd
+  Driver::Callback callback_;
+  std::shared_ptr<DeliveryQueue> queue_;
+  std::shared_ptr<BufferPool> bufferPool_;
+  std::atomic<bool> keepRunning_{false};
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> numDelivered_{0};
+  std::thread thread_;
+};
+}  // namespace flir_spinnaker_common
+#endif  // FLIR_SPINNAKER_COMMON__PLAYER_H_
@@ -0,0 +1,151 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLIR_SPINNAKER_COMMON__RECORDER_H_
+#define FLIR_SPINNAKER_COMMON__RECORDER_H_
+
+#include <flir_spinnaker_common/image.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+class BufferPool;
+class DeliveryQueue;
+//
+// Records raw frames and their metadata to disk. Frames are queued by
+// write() and stored by a set of writer threads, each into its own
+// sequence of preallocated chunk files, with O_DIRECT where the file
+// system supports it. Each frame is one record: a RecordHeader padded
+// to ALIGNMENT, followed by the image data, padded to a multiple of
+// ALIGNMENT. Aligned image buffers are written without a copy.
+// The index file has an IndexHeader followed by one fixed size
+// IndexEntry per frame, in the order the frames were written.
+//
+// Files: <baseName>_<writer>_<chunk>.raw and <baseName>.idx
+//
+class Recorder
+{
+public:
+  static const size_t ALIGNMENT = 4096;
+  static const uint32_t RECORD_MAGIC = 0x46525346;  // "FSRF"
+  static const uint32_t INDEX_MAGIC = 0x49525346;  // "FSRI"
+  static const uint32_t VERSION = 1;
+
+  struct Config
+  {
+    std::string directory{"."};
+    std::string baseName{"frames"};
+    int numWriterThreads{2};
+    size_t chunkSize{size_t(1) << 30};  // bytes preallocated per chunk
+    // Frames waiting for a writer. Queued zero copy frames hold camera
+    // buffers: with queueSize + numWriterThreads above the driver's
+    // maxHeldBuffers (default: 8), the driver copies the frames.
+    size_t queueSize{6};
+    bool directIO{true};
+  };
+  struct Statistics
+  {
+    uint64_t numWritten{0};
+    uint64_t bytesWritten{0};
+    // frames dropped because the writers could not keep up
+    uint64_t numDropped{0};
+    uint64_t numErrors{0};  // frames lost to I/O errors
+    size_t queueDepth{0};
+  };
+  struct RecordHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;  // image data starts here
+    uint32_t pixelFormat;
+    uint64_t frameId;
+    uint64_t time;  // host time (nsec)
+    int64_t imageTime;  // camera time stamp
+    uint64_t imageSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t bitsPerPixel;
+    uint32_t numChannels;
+    int32_t imageStatus;
+    uint32_t exposureTime;
+    uint32_t maxExposureTime;
+    float gain;
+    int16_t brightness;
+    uint16_t padding;
+    uint64_t correctedTime;  // 0 if not known, see Image::correctedTime_
+    uint32_t offsetX;
+    uint32_t offsetY;
+    uint16_t reserved[12];
+  };
+  struct IndexHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t reserved;
+  };
+  struct IndexEntry
+  {
+    uint64_t frameId;
+    uint64_t time;
+    int64_t imageTime;
+    uint32_t writer;  // chunk file <writer>_<chunk>
+    uint32_t chunk;
+    uint64_t offset;  // of the record within the chunk file
+    uint64_t recordSize;  // header + data + padding
+  };
+
+  explicit Recorder(const Config & config);
+  ~Recorder();
+  bool open();
+  // Writes out the queued frames (frames still queued after 10s count
+  // as dropped), then syncs and closes the files.
+  void close();
+  // Never blocks for I/O. Frames that arrive while the queue is full
+  // are dropped and counted. Images without a buffer holder (no zero
+  // copy) are copied before they are queued.
+  void write(const ImageConstPtr & img);
+  Statistics getStatistics() const;
+
+  struct Writer;  // per writer thread state
+
+private:
+  void writeRecord(const ImageConstPtr & img);
+  bool openChunk(Writer * w);
+  void closeChunk(Writer * w);
+  std::string getChunkName(int writer, int chunk) const;
+  // ----- variables --
+  Config config_;
+  std::shared_ptr<DeliveryQueue> queue_;
+  std::shared_ptr<BufferPool> copyPool_;
+  std::vector<std::shared_ptr<Writer>> writers_;
+  std::vector<Writer *> freeWriters_;
+  std::mutex writerMutex_;
+  int indexFd_{-1};
+  std::mutex indexMutex_;
+  std::atomic<uint64_t> numWritten_{0};
+  std::atomic<uint64_t> bytesWritten_{0};
+  std::atomic<uint64_t> numErrors_{0};
+  std::atomic<uint64_t> numDroppedClosed_{0};
+};
+}  // namespace flir_spinnaker_common
+#endif  // FLIR_SPINNAKER_COMMON__RECORDER_H_
@@ -0,0 +1,57 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLIR_SPINNAKER_COMMON__UNPACK_H_
+#define FLIR_SPINNAKER_COMMON__UNPACK_H_
+
+#include <flir_spinnaker_common/image.h>
+#include <flir_spinnaker_common/pixel_format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace flir_spinnaker_common
+{
+namespace unpack
+{
+//
+// Unpacks Mono10p, Mono12p, Mono10Packed, Mono12Packed, BayerRG10p,
+// BayerRG12p, BayerRG10Packed and BayerRG12Packed to one 16 bit value
+// per pixel. The values keep their original range (e.g. 0..4095 for
+// 12 bit). Rows are split across the processing threads, numThreads
+// limits how many are used (0 = all cores).
+//
+
+// true if the format is one of the above
+bool is_packed(pixel_format::PixelFormat pf);
+// unpacks into caller provided buffer, dstStride is in bytes.
+// Returns false if the format is not packed.
+bool unpack(
+  pixel_format::PixelFormat pf, const uint8_t * src, size_t w, size_t h,
+  size_t srcStride, uint16_t * dst, size_t dstStride, int numThreads = 0);
+bool unpack(
+  const Image & img, uint16_t * dst, size_t dstStride, int numThreads = 0);
+// unpacks into a pooled buffer of width * height values without padding,
+// which is recycled when released. Returns null if the format is not packed.
+std::shared_ptr<uint16_t> unpack(const Image & img, int numThreads = 0);
+// name of the instruction set used: "ssse3" or "scalar"
+const char * get_instruction_set();
+// Overrides the instruction set picked at startup, e.g. to test all
+// code paths. Returns false if the CPU does not support it.
+bool set_instruction_set(const char * name);
+}  // namespace unpack
+}  // namespace flir_spinnaker_common
+#endif  // FLIR_SPINNAKER_COMMON__UNPACK_H_
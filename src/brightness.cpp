@@ -0,0 +1,576 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "brightness.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BRIGHTNESS_HAS_X86
+#endif
+
+namespace flir_spinnaker_common
+{
+namespace brightness
+{
+using pixel_format::PixelFormat;
+
+// how to sum up a row of a given pixel format
+enum RowKind {
+  UNSUPPORTED,
+  BYTES,  // every byte is a sample (mono8, bayer8, rgb8)
+  BGRA,  // 4 bytes per pixel, last one is ignored
+  WORDS,  // little endian 16 bit
+  PACKED_10P,  // 4 pixels in 5 bytes, LSB first
+  PACKED_12P,  // 2 pixels in 3 bytes, LSB first
+  PACKED_10,  // GigE Vision "Packed": 2 pixels in 3 bytes
+  PACKED_12,
+  LUMA  // YUV/YCbCr, only the luma bytes are used
+};
+
+static constexpr RowKind row_kind(const pixel_format::Traits & t)
+{
+  switch (t.layout) {
+    case pixel_format::LAYOUT_NONE:
+      return (UNSUPPORTED);
+    case pixel_format::LAYOUT_BGRA:
+      return (BGRA);
+    case pixel_format::LAYOUT_MONO:
+    case pixel_format::LAYOUT_RGB:
+    case pixel_format::LAYOUT_BGR:
+      break;
+    default:
+      return (LUMA);
+  }
+  if (t.packing == pixel_format::PACKED_LSB) {
+    return (t.bitDepth == 10 ? PACKED_10P : PACKED_12P);
+  }
+  if (t.packing == pixel_format::PACKED_GIGE) {
+    return (t.bitDepth == 10 ? PACKED_10 : PACKED_12);
+  }
+  return (t.bitDepth == 16 ? WORDS : BYTES);
+}
+
+// bytes and pixels per group, and the position of the luma bytes
+struct PixelGroup
+{
+  int groupBytes;
+  int groupPixels;
+  int lumaOffset[4];
+};
+
+static constexpr PixelGroup luma_group(pixel_format::ChannelLayout l)
+{
+  switch (l) {
+    case pixel_format::LAYOUT_UYYVYY:
+      return {6, 4, {1, 2, 4, 5}};
+    case pixel_format::LAYOUT_UYVY:
+      return {4, 2, {1, 3, 0, 0}};
+    case pixel_format::LAYOUT_UYV:
+      return {3, 1, {1, 0, 0, 0}};
+    case pixel_format::LAYOUT_YCBCR:
+      return {3, 1, {0, 0, 0, 0}};
+    case pixel_format::LAYOUT_YCBYCR:
+      return {4, 2, {0, 2, 0, 0}};
+    case pixel_format::LAYOUT_YYCBYYCR:
+      return {6, 4, {0, 1, 3, 4}};
+    default:
+      return {1, 1, {0, 0, 0, 0}};
+  }
+}
+
+// ------------- row sums for the vectorizable formats
+
+typedef uint64_t (*SumFunction)(const uint8_t * p, size_t n);
+struct Kernels
+{
+  SumFunction sumBytes;  // n bytes
+  SumFunction sumBGRA;  // n pixels
+  SumFunction sumWords;  // n words
+  const char * name;
+};
+
+static uint64_t sum_bytes_scalar(const uint8_t * p, size_t n)
+{
+  uint64_t s = 0;
+  for (size_t i = 0; i < n; i++) {
+    s += p[i];
+  }
+  return (s);
+}
+
+static uint64_t sum_bgra_scalar(const uint8_t * p, size_t n)
+{
+  uint64_t s = 0;
+  for (size_t i = 0; i < n; i++, p += 4) {
+    s += p[0] + p[1] + p[2];
+  }
+  return (s);
+}
+
+static uint64_t sum_words_scalar(const uint8_t * p, size_t n)
+{
+  uint64_t s = 0;
+  for (size_t i = 0; i < n; i++, p += 2) {
+    s += static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+  }
+  return (s);
+}
+
+#ifdef BRIGHTNESS_HAS_X86
+// The 32 bit lanes of the word sums overflow after 2^15 iterations,
+// flush them into 64 bit well before that.
+static const size_t WORD_FLUSH_INTERVAL = 8192;
+
+static uint64_t hsum_epi64(__m128i v)
+{
+  return (
+    static_cast<uint64_t>(_mm_cvtsi128_si64(v)) +
+    static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v))));
+}
+
+static __m128i widen_add_epi32(__m128i acc64, __m128i v32)
+{
+  const __m128i zero = _mm_setzero_si128();
+  acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(v32, zero));
+  return (_mm_add_epi64(acc64, _mm_unpackhi_epi32(v32, zero)));
+}
+
+static uint64_t sum_bytes_sse2(const uint8_t * p, size_t n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+  }
+  return (hsum_epi64(acc) + sum_bytes_scalar(p + i, n - i));
+}
+
+static uint64_t sum_bgra_sse2(const uint8_t * p, size_t n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i v =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 4 * i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+  }
+  return (hsum_epi64(acc) + sum_bgra_scalar(p + 4 * i, n - i));
+}
+
+static uint64_t sum_words_sse2(const uint8_t * p, size_t n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc64 = _mm_setzero_si128();
+  size_t i = 0;
+  while (i + 8 <= n) {
+    __m128i acc32 = _mm_setzero_si128();
+    for (size_t k = 0; k < WORD_FLUSH_INTERVAL && i + 8 <= n; k++, i += 8) {
+      const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2 * i));
+      acc32 = _mm_add_epi32(acc32, _mm_unpacklo_epi16(v, zero));
+      acc32 = _mm_add_epi32(acc32, _mm_unpackhi_epi16(v, zero));
+    }
+    acc64 = widen_add_epi32(acc64, acc32);
+  }
+  return (hsum_epi64(acc64) + sum_words_scalar(p + 2 * i, n - i));
+}
+
+__attribute__((target("avx2"))) static uint64_t hsum_epi64_avx2(__m256i v)
+{
+  return (hsum_epi64(_mm_add_epi64(
+    _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1))));
+}
+
+__attribute__((target("avx2"))) static uint64_t sum_bytes_avx2(
+  const uint8_t * p, size_t n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m256i v =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, zero));
+  }
+  return (hsum_epi64_avx2(acc) + sum_bytes_sse2(p + i, n - i));
+}
+
+__attribute__((target("avx2"))) static uint64_t sum_bgra_avx2(
+  const uint8_t * p, size_t n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i mask = _mm256_set1_epi32(0x00FFFFFF);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i v =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 4 * i));
+    acc =
+      _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_and_si256(v, mask), zero));
+  }
+  return (hsum_epi64_avx2(acc) + sum_bgra_sse2(p + 4 * i, n - i));
+}
+
+__attribute__((target("avx2"))) static uint64_t sum_words_avx2(
+  const uint8_t * p, size_t n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc64 = _mm256_setzero_si256();
+  size_t i = 0;
+  while (i + 16 <= n) {
+    __m256i acc32 = _mm256_setzero_si256();
+    for (size_t k = 0; k < WORD_FLUSH_INTERVAL && i + 16 <= n; k++, i += 16) {
+      const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2 * i));
+      acc32 = _mm256_add_epi32(acc32, _mm256_unpacklo_epi16(v, zero));
+      acc32 = _mm256_add_epi32(acc32, _mm256_unpackhi_epi16(v, zero));
+    }
+    acc64 = _mm256_add_epi64(acc64, _mm256_unpacklo_epi32(acc32, zero));
+    acc64 = _mm256_add_epi64(acc64, _mm256_unpackhi_epi32(acc32, zero));
+  }
+  return (hsum_epi64_avx2(acc64) + sum_words_sse2(p + 2 * i, n - i));
+}
+#endif
+
+static const Kernels scalar_kernels{
+  sum_bytes_scalar, sum_bgra_scalar, sum_words_scalar, "scalar"};
+#ifdef BRIGHTNESS_HAS_X86
+static const Kernels sse2_kernels{
+  sum_bytes_sse2, sum_bgra_sse2, sum_words_sse2, "sse2"};
+static const Kernels avx2_kernels{
+  sum_bytes_avx2, sum_bgra_avx2, sum_words_avx2, "avx2"};
+#endif
+
+// null if the CPU does not support the instruction set
+static const Kernels * find_kernels(const char * name)
+{
+#ifdef BRIGHTNESS_HAS_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+    return (&avx2_kernels);
+  }
+  if (!strcmp(name, "sse2")) {
+    return (&sse2_kernels);
+  }
+#endif
+  return (!strcmp(name, "scalar") ? &scalar_kernels : nullptr);
+}
+
+static const Kernels * select_kernels()
+{
+  for (const char * name : {"avx2", "sse2"}) {
+    const Kernels * k = find_kernels(name);
+    if (k) {
+      return (k);
+    }
+  }
+  return (&scalar_kernels);
+}
+
+static std::atomic<const Kernels *> & current_kernels()
+{
+  static std::atomic<const Kernels *> kernels{select_kernels()};
+  return (kernels);
+}
+
+static const Kernels & get_kernels()
+{
+  return (*current_kernels().load(std::memory_order_relaxed));
+}
+
+// ------------- row sums for packed and luma formats, always scalar
+
+// the pixels of one group of packed bytes
+static inline void decode_10p(const uint8_t * p, uint32_t * v)
+{
+  v[0] = p[0] | ((p[1] & 0x03) << 8);
+  v[1] = (p[1] >> 2) | ((p[2] & 0x0F) << 6);
+  v[2] = (p[2] >> 4) | ((p[3] & 0x3F) << 4);
+  v[3] = (p[3] >> 6) | (p[4] << 2);
+}
+
+static inline void decode_12p(const uint8_t * p, uint32_t * v)
+{
+  v[0] = p[0] | ((p[1] & 0x0F) << 8);
+  v[1] = (p[1] >> 4) | (p[2] << 4);
+}
+
+static inline void decode_10(const uint8_t * p, uint32_t * v)
+{
+  v[0] = (p[0] << 2) | (p[1] & 0x03);
+  v[1] = (p[2] << 2) | ((p[1] >> 4) & 0x03);
+}
+
+static inline void decode_12(const uint8_t * p, uint32_t * v)
+{
+  v[0] = (p[0] << 4) | (p[1] & 0x0F);
+  v[1] = (p[2] << 4) | (p[1] >> 4);
+}
+
+// bytes and pixels per group of the packed and luma formats
+template <PixelFormat F>
+static constexpr PixelGroup pixel_group()
+{
+  switch (row_kind(pixel_format::get_traits(F))) {
+    case PACKED_10P:
+      return {5, 4, {0, 0, 0, 0}};
+    case PACKED_12P:
+    case PACKED_10:
+    case PACKED_12:
+      return {3, 2, {0, 0, 0, 0}};
+    case LUMA:
+      return (luma_group(pixel_format::get_traits(F).layout));
+    default:
+      return {1, 1, {0, 0, 0, 0}};
+  }
+}
+
+template <void (*Decode)(const uint8_t *, uint32_t *), int N, int B>
+static uint64_t sum_packed(const uint8_t * p, size_t groups)
+{
+  uint64_t s = 0;
+  uint32_t v[N];
+  for (size_t i = 0; i < groups; i++, p += B) {
+    Decode(p, v);
+    for (int k = 0; k < N; k++) {
+      s += v[k];
+    }
+  }
+  return (s);
+}
+
+template <pixel_format::ChannelLayout L>
+static uint64_t sum_luma(const uint8_t * p, size_t groups)
+{
+  constexpr PixelGroup g = luma_group(L);
+  uint64_t s = 0;
+  for (size_t i = 0; i < groups; i++, p += g.groupBytes) {
+    for (int k = 0; k < g.groupPixels; k++) {
+      s += p[g.lumaOffset[k]];
+    }
+  }
+  return (s);
+}
+
+// returns the sum over one row and the number of samples in it
+template <PixelFormat F>
+static uint64_t sum_row(
+  const Kernels & k, const uint8_t * row, size_t w, uint64_t * cnt)
+{
+  constexpr pixel_format::Traits t = pixel_format::get_traits(F);
+  constexpr int n = pixel_group<F>().groupPixels;
+  switch (row_kind(t)) {
+    case BYTES:
+      *cnt = w * t.numChannels;
+      return (k.sumBytes(row, w * t.numChannels));
+    case BGRA:
+      *cnt = w * 3;
+      return (k.sumBGRA(row, w));
+    case WORDS:
+      *cnt = w;
+      return (k.sumWords(row, w));
+    case PACKED_10P:
+      *cnt = (w / n) * n;
+      return (sum_packed<decode_10p, 4, 5>(row, w / n));
+    case PACKED_12P:
+      *cnt = (w / n) * n;
+      return (sum_packed<decode_12p, 2, 3>(row, w / n));
+    case PACKED_10:
+      *cnt = (w / n) * n;
+      return (sum_packed<decode_10, 2, 3>(row, w / n));
+    case PACKED_12:
+      *cnt = (w / n) * n;
+      return (sum_packed<decode_12, 2, 3>(row, w / n));
+    case LUMA:
+      *cnt = (w / n) * n;
+      return (sum_luma<t.layout>(row, w / n));
+    default:
+      *cnt = 0;
+      return (0);
+  }
+}
+
+// ------------- sampling every step'th pixel of a row
+
+// sum over the channels of pixel x
+template <PixelFormat F>
+static uint32_t pixel_sum(const uint8_t * row, size_t x)
+{
+  constexpr pixel_format::Traits t = pixel_format::get_traits(F);
+  constexpr PixelGroup g = pixel_group<F>();
+  const uint8_t * p = row + (x / g.groupPixels) * g.groupBytes;
+  uint32_t v[4];
+  switch (row_kind(t)) {
+    case BYTES: {
+      uint32_t s = 0;
+      for (int c = 0; c < t.numChannels; c++) {
+        s += row[x * t.numChannels + c];
+      }
+      return (s);
+    }
+    case BGRA:
+      return (row[4 * x] + row[4 * x + 1] + row[4 * x + 2]);
+    case WORDS:
+      return (row[2 * x] | (row[2 * x + 1] << 8));
+    case PACKED_10P:
+      decode_10p(p, v);
+      break;
+    case PACKED_12P:
+      decode_12p(p, v);
+      break;
+    case PACKED_10:
+      decode_10(p, v);
+      break;
+    case PACKED_12:
+      decode_12(p, v);
+      break;
+    case LUMA:
+      return (p[g.lumaOffset[x % g.groupPixels]]);
+    default:
+      return (0);
+  }
+  return (v[x % g.groupPixels]);
+}
+
+// Sums pixels 0, step, 2 * step, ... of a row, and with pairs the
+// pixels to their right as well. Only the sample points are loaded.
+template <PixelFormat F, bool Pairs>
+static uint64_t sum_row_sampled(
+  const uint8_t * row, size_t w, size_t step, uint64_t * cnt)
+{
+  constexpr pixel_format::Traits t = pixel_format::get_traits(F);
+  constexpr int n = pixel_group<F>().groupPixels;
+  constexpr int channels =
+    row_kind(t) == BYTES ? t.numChannels : (row_kind(t) == BGRA ? 3 : 1);
+  const size_t numPixels = (w / n) * n;  // complete groups only
+  if (numPixels == 0) {
+    *cnt = 0;
+    return (0);
+  }
+  const size_t numPoints = (numPixels + step - 1) / step;
+  uint64_t s = 0;
+  size_t x = 0;
+  // the last point may lack its right neighbor
+  for (size_t i = 0; i + 1 < numPoints; i++, x += step) {
+    s += pixel_sum<F>(row, x);
+    if (Pairs) {
+      s += pixel_sum<F>(row, x + 1);
+    }
+  }
+  s += pixel_sum<F>(row, x);
+  size_t c = numPoints;
+  if (Pairs) {
+    c += numPoints - 1;
+    if (x + 1 < numPixels) {
+      s += pixel_sum<F>(row, x + 1);
+      c++;
+    }
+  }
+  *cnt = c * channels;
+  return (s);
+}
+
+// instantiated per pixel format by pixel_format::dispatch()
+template <PixelFormat F>
+struct MeanKernel
+{
+  static double run(
+    const Kernels & k, const uint8_t * data, size_t w, size_t h,
+    size_t stride, int skip)
+  {
+    constexpr pixel_format::Traits t = pixel_format::get_traits(F);
+    if (row_kind(t) == UNSUPPORTED || !data) {
+      return (-1.0);
+    }
+    const size_t step = skip > 0 ? static_cast<size_t>(skip) : 1;
+    // for bayer images sample 2x2 blocks to get all colors
+    const bool blocks = t.cfa != pixel_format::NO_CFA && step > 1;
+    const size_t rowsPerStep = blocks ? 2 : 1;
+    uint64_t tot = 0;
+    uint64_t cnt = 0;
+    for (size_t row = 0; row < h; row += step) {
+      for (size_t r = row; r < row + rowsPerStep && r < h; r++) {
+        uint64_t c;
+        const uint8_t * p = data + r * stride;
+        tot += step == 1 ? sum_row<F>(k, p, w, &c)
+                         : (blocks ? sum_row_sampled<F, true>(p, w, step, &c)
+                                   : sum_row_sampled<F, false>(p, w, step, &c));
+        cnt += c;
+      }
+    }
+    return (cnt > 0 ? static_cast<double>(tot) / cnt : 0);
+  }
+};
+
+template <PixelFormat F>
+struct BrightnessKernel
+{
+  static int16_t run(
+    const Kernels & k, const uint8_t * data, size_t w, size_t h,
+    size_t stride, int skip)
+  {
+    constexpr int bitDepth = pixel_format::get_traits(F).bitDepth;
+    constexpr int shift = bitDepth > 8 ? bitDepth - 8 : 0;
+    const double mean = MeanKernel<F>::run(k, data, w, h, stride, skip);
+    if (mean < 0) {
+      return (-1);
+    }
+    return (static_cast<int16_t>(static_cast<uint32_t>(mean) >> shift));
+  }
+};
+
+double compute_mean(
+  PixelFormat pf, const uint8_t * data, size_t w, size_t h, size_t stride,
+  int skip)
+{
+  return (pixel_format::dispatch<MeanKernel>(
+    pf, get_kernels(), data, w, h, stride, skip));
+}
+
+double compute_mean_scalar(
+  PixelFormat pf, const uint8_t * data, size_t w, size_t h, size_t stride,
+  int skip)
+{
+  return (pixel_format::dispatch<MeanKernel>(
+    pf, scalar_kernels, data, w, h, stride, skip));
+}
+
+int16_t compute_brightness(
+  PixelFormat pf, const uint8_t * data, size_t w, size_t h, size_t stride,
+  int skip)
+{
+  return (pixel_format::dispatch<BrightnessKernel>(
+    pf, get_kernels(), data, w, h, stride, skip));
+}
+
+const char * get_instruction_set() { return (get_kernels().name); }
+
+bool set_instruction_set(const char * name)
+{
+  const Kernels * k = find_kernels(name);
+  if (k) {
+    current_kernels().store(k, std::memory_order_relaxed);
+  }
+  return (k != nullptr);
+}
+}  // namespace brightness
+}  // namespace flir_spinnaker_common
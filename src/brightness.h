@@ -0,0 +1,56 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BRIGHTNESS_H_
+#define BRIGHTNESS_H_
+
+#include <flir_spinnaker_common/pixel_format.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flir_spinnaker_common
+{
+namespace brightness
+{
+//
+// Mean intensity of an image, sampled at every skip'th pixel of
+// every skip'th row. For Bayer images, 2x2 blocks are sampled so all
+// colors contribute. With skip <= 1 all pixels are summed, using SIMD
+// where available. Color images average over all color channels
+// (alpha is ignored), YUV/YCbCr images use the luma channel.
+//
+
+// mean in units of the pixel format (e.g. 0..4095 for 12 bit),
+// negative if the format is not supported
+double compute_mean(
+  pixel_format::PixelFormat pf, const uint8_t * data, size_t w, size_t h,
+  size_t stride, int skip);
+// mean scaled to 8 bits (0..255), -1 if the format is not supported
+int16_t compute_brightness(
+  pixel_format::PixelFormat pf, const uint8_t * data, size_t w, size_t h,
+  size_t stride, int skip);
+// plain C++ reference implementation, same results as compute_mean()
+double compute_mean_scalar(
+  pixel_format::PixelFormat pf, const uint8_t * data, size_t w, size_t h,
+  size_t stride, int skip);
+// name of the instruction set used: "avx2", "sse2" or "scalar"
+const char * get_instruction_set();
+// Overrides the instruction set picked at startup, e.g. to test all
+// code paths. Returns false if the CPU does not support it.
+bool set_instruction_set(const char * name);
+}  // namespace brightness
+}  // namespace flir_spinnaker_common
+#endif  // BRIGHTNESS_H_
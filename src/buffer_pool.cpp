@@ -0,0 +1,81 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace flir_spinnaker_common
+{
+// holds the control block of a shared_ptr with the recycling deleter
+static const size_t CONTROL_BLOCK_SIZE = 128;
+
+BufferPool::BufferPool(size_t maxFree, size_t alignment)
+: maxFree_(maxFree),
+  alignment_(alignment),
+  // the buffers in use plus the free ones, more fall back to the heap
+  controlBlocks_(std::make_shared<MemoryPool>(
+    CONTROL_BLOCK_SIZE, std::max(2 * maxFree, static_cast<size_t>(4))))
+{
+}
+
+BufferPool::~BufferPool()
+{
+  for (auto & f : free_) {
+    free(f.second);
+  }
+}
+
+std::shared_ptr<uint8_t> BufferPool::get(size_t size)
+{
+  uint8_t * p = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+      if (it->first == size) {
+        p = it->second;
+        free_.erase(it);
+        break;
+      }
+    }
+  }
+  if (!p) {
+    void * m;
+    if (posix_memalign(&m, alignment_, size) != 0) {
+      throw std::bad_alloc();
+    }
+    p = static_cast<uint8_t *>(m);
+  }
+  // the deleter keeps the pool alive
+  std::shared_ptr<BufferPool> self = shared_from_this();
+  return (std::shared_ptr<uint8_t>(
+    p, [self, size](uint8_t * b) { self->putBack(b, size); },
+    PoolAllocator<uint8_t>(controlBlocks_)));
+}
+
+void BufferPool::putBack(uint8_t * p, size_t size)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_.size() < maxFree_) {
+      free_.emplace_back(size, p);
+      return;
+    }
+  }
+  free(p);
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,55 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "memory_pool.h"
+
+namespace flir_spinnaker_common
+{
+//
+// Recycles large image buffers. A buffer goes back to the pool when
+// the last shared pointer to it is dropped. The alignment must be a
+// power of two, e.g. the block size for O_DIRECT writes. The control
+// blocks of the shared pointers are pooled as well, so recycling a
+// buffer does not touch the heap.
+//
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+  explicit BufferPool(size_t maxFree, size_t alignment = 64);
+  ~BufferPool();
+  std::shared_ptr<uint8_t> get(size_t size);
+
+private:
+  void putBack(uint8_t * p, size_t size);
+  // ----- variables --
+  size_t maxFree_;
+  size_t alignment_;
+  std::shared_ptr<MemoryPool> controlBlocks_;
+  std::mutex mutex_;
+  std::vector<std::pair<size_t, uint8_t *>> free_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // BUFFER_POOL_H_
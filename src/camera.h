@@ -0,0 +1,143 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#include <flir_spinnaker_common/driver.h>
+#include <flir_spinnaker_common/image.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "memory_pool.h"
+
+namespace flir_spinnaker_common
+{
+// One frame as delivered by a camera backend. The data is only valid
+// until Camera::FrameHandler::onFrame() returns, unless the frame is
+// held with Camera::holdFrame().
+struct CameraFrame
+{
+  const void * data{nullptr};
+  size_t imageSize{0};
+  size_t width{0};
+  size_t height{0};
+  size_t stride{0};  // in bytes
+  size_t offsetX{0};  // of the region of interest on the sensor
+  size_t offsetY{0};
+  size_t bitsPerPixel{0};
+  size_t numChannels{0};
+  uint64_t frameId{0};
+  int64_t imageTime{0};  // time stamp from the camera
+  float exposureTime{0};  // usec
+  float gain{0};  // dB
+  uint32_t maxExposureTime{0};
+  int status{0};
+  bool incomplete{false};
+  void * handle{nullptr};  // backend specific reference to the buffer
+};
+
+//
+// The part of a camera that the driver depends on: lifecycle,
+// acquisition, buffer ownership and typed node access. Implemented
+// on top of the Spinnaker SDK, and by a synthetic camera that runs
+// without SDK and hardware.
+//
+class Camera
+{
+public:
+  class FrameHandler
+  {
+  public:
+    virtual ~FrameHandler() {}
+    // called on the camera's acquisition thread
+    virtual void onFrame(const CameraFrame & frame) = 0;
+  };
+  virtual ~Camera() {}
+  void setDebug(bool b) { debug_ = b; }
+  // applies from the next startAcquisition()
+  void setAcquisitionThreadConfig(const Driver::AcquisitionThreadConfig & c)
+  {
+    threadConfig_ = c;
+  }
+
+  virtual void init() = 0;
+  virtual void deInit() = 0;
+  // frames are passed to the handler until stopAcquisition()
+  virtual void startAcquisition(FrameHandler * handler) = 0;
+  virtual void stopAcquisition() = 0;
+  // stops and restarts the stream, keeping the handler
+  virtual void restartAcquisition() = 0;
+  // Keeps the buffer of a frame from being reused until the returned
+  // pointer and all its copies are gone. Decrements numHeld when the
+  // buffer is handed back. Only valid inside onFrame().
+  virtual std::shared_ptr<void> holdFrame(
+    const CameraFrame & frame,
+    const std::shared_ptr<std::atomic<int>> & numHeld,
+    const PoolAllocator<Image> & alloc) = 0;
+  virtual std::string getStatusDescription(int status) const = 0;
+
+  // node access, same semantics as the Driver::set*() methods
+  virtual std::string setEnum(
+    const std::string & nodeName, const std::string & val,
+    std::string * retVal) = 0;
+  virtual std::string setDouble(
+    const std::string & nodeName, double val, double * retVal) = 0;
+  virtual std::string setInt(
+    const std::string & nodeName, int val, int * retVal) = 0;
+  virtual std::string setBool(
+    const std::string & nodeName, bool val, bool * retVal) = 0;
+  // the getters return false if the node cannot be read
+  virtual bool getEnum(const std::string & nodeName, std::string * val) = 0;
+  virtual bool getDouble(const std::string & nodeName, double * val) = 0;
+  virtual bool getInt(const std::string & nodeName, int64_t * val) = 0;
+  virtual bool getBool(const std::string & nodeName, bool * val) = 0;
+  virtual bool getString(const std::string & nodeName, std::string * val) = 0;
+  // current limits and increment of an integer node
+  virtual bool getIntLimits(
+    const std::string & nodeName, int64_t * min, int64_t * max,
+    int64_t * inc) = 0;
+  // runs a command node (e.g. UserSetSave), false if not possible
+  virtual bool execute(const std::string & nodeName) = 0;
+  // true if the node exists but cannot be written at the moment
+  virtual bool isLocked(const std::string & nodeName) = 0;
+  // Fast path for the exposure controller, clamps to the node limits.
+  // Returns false if the exposure time cannot be written.
+  virtual bool setExposure(double exposureTime, double gain) = 0;
+  virtual std::string getNodeMapAsString() = 0;
+
+  // Stream buffers: the number in use and the transport layer's
+  // default. The count is clamped to the allowed range. The handling
+  // mode is "OldestFirst", "NewestOnly", etc. Changes apply from the
+  // next start of acquisition. The setters return false on failure.
+  virtual int64_t getStreamBufferCount() = 0;
+  virtual int64_t getDefaultStreamBufferCount() = 0;
+  virtual bool setStreamBufferCount(int64_t count) = 0;
+  virtual bool setStreamBufferHandling(const std::string & mode) = 0;
+  // fills in the stream counters
+  virtual void getStreamStatistics(Driver::FrameDropStatistics * s) = 0;
+
+protected:
+  bool debug_{false};
+  Driver::AcquisitionThreadConfig threadConfig_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // CAMERA_H_
@@ -0,0 +1,123 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "clock_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+// length of a window in camera time
+static const uint64_t WINDOW_TIME = 1000000000ULL;
+// camera clock jumps larger than this start the estimate over
+static const int64_t MAX_JUMP = 1000000000LL;
+// anything beyond this is not clock drift (ppm * 1e-6)
+static const double MAX_SLOPE = 1e-3;
+
+void ClockEstimator::reset()
+{
+  numPoints_ = 0;
+  nextPoint_ = 0;
+  lastCameraTime_ = 0;
+  windowStart_ = 0;
+  windowEmpty_ = true;
+  haveFit_ = false;
+  slope_ = 0;
+  drift_ = 0;
+}
+
+uint64_t ClockEstimator::update(uint64_t hostTime, uint64_t cameraTime)
+{
+  if (cameraTime == 0) {
+    return (0);
+  }
+  const int64_t offset =
+    static_cast<int64_t>(hostTime) - static_cast<int64_t>(cameraTime);
+  if (
+    haveFit_ && (cameraTime <= lastCameraTime_ ||
+                 std::abs(offset - predict(cameraTime)) > MAX_JUMP)) {
+    reset();  // camera clock was reset, or a different camera
+  }
+  lastCameraTime_ = cameraTime;
+  if (windowEmpty_) {
+    windowStart_ = cameraTime;
+  }
+  if (windowEmpty_ || offset < windowMin_.offset) {
+    windowMin_ = Point{cameraTime, offset};
+    windowEmpty_ = false;
+  }
+  if (!haveFit_ || (numPoints_ == 0 && offset < offset_)) {
+    // until the first window is complete, follow the fastest frame
+    origin_ = cameraTime;
+    offset_ = offset;
+    haveFit_ = true;
+  }
+  if (cameraTime - windowStart_ >= WINDOW_TIME) {
+    points_[nextPoint_] = windowMin_;
+    nextPoint_ = (nextPoint_ + 1) % NUM_WINDOWS;
+    numPoints_ = std::min(numPoints_ + 1, NUM_WINDOWS);
+    windowEmpty_ = true;
+    fit();
+  }
+  // a frame can not arrive before it was taken
+  return (static_cast<uint64_t>(
+    static_cast<int64_t>(cameraTime) + std::min(predict(cameraTime), offset)));
+}
+
+void ClockEstimator::fit()
+{
+  // relative to the last point
+  const Point & last = points_[(nextPoint_ + NUM_WINDOWS - 1) % NUM_WINDOWS];
+  std::array<double, NUM_WINDOWS> x, y;
+  for (size_t i = 0; i < numPoints_; i++) {
+    x[i] = static_cast<double>(
+      static_cast<int64_t>(points_[i].cameraTime) -
+      static_cast<int64_t>(last.cameraTime));
+    y[i] = static_cast<double>(points_[i].offset - last.offset);
+  }
+  // Theil-Sen: the median of the pairwise slopes ignores windows in
+  // which all frames were late
+  std::vector<double> slopes;
+  slopes.reserve(numPoints_ * (numPoints_ - 1) / 2);
+  for (size_t i = 0; i < numPoints_; i++) {
+    for (size_t j = i + 1; j < numPoints_; j++) {
+      if (x[j] != x[i]) {
+        slopes.push_back((y[j] - y[i]) / (x[j] - x[i]));
+      }
+    }
+  }
+  double slope = 0;
+  if (!slopes.empty()) {
+    std::nth_element(
+      slopes.begin(), slopes.begin() + slopes.size() / 2, slopes.end());
+    slope = std::min(
+      std::max(slopes[slopes.size() / 2], -MAX_SLOPE), MAX_SLOPE);
+  }
+  // lowest line with that slope that has no point below it
+  double minY = 0;
+  for (size_t i = 0; i < numPoints_; i++) {
+    minY = std::min(minY, y[i] - slope * x[i]);
+  }
+  origin_ = last.cameraTime;
+  offset_ = last.offset + static_cast<int64_t>(std::floor(minY));
+  slope_ = slope;
+  // the offset shrinks when the camera clock runs fast
+  drift_ = -slope;
+}
+}  // namespace flir_spinnaker_common
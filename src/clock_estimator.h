@@ -0,0 +1,84 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CLOCK_ESTIMATOR_H_
+#define CLOCK_ESTIMATOR_H_
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace flir_spinnaker_common
+{
+//
+// Maps camera time stamps into host time. The arrival time of a frame
+// is its camera time plus the clock offset plus a delivery delay that
+// jitters by milliseconds but never goes below some minimum. In every
+// window of camera time, the frame with the smallest difference is
+// taken to have had that minimal delay. A robust line fit through the
+// last windows gives offset and drift, and is set to pass below all
+// of them. The mapped times keep the minimal delivery delay as a
+// constant bias, but lose the jitter.
+// Only one thread (the acquisition thread) may call update() and
+// reset(). The drift can be read from any thread.
+//
+class ClockEstimator
+{
+public:
+  ClockEstimator() { reset(); }
+  // Times in nsec. Returns the camera time mapped into host time, or
+  // 0 for a camera time of 0.
+  uint64_t update(uint64_t hostTime, uint64_t cameraTime);
+  void reset();
+  // of the camera clock relative to the host clock, in ppm
+  double getDrift() const { return (drift_.load() * 1e6); }
+
+private:
+  static const size_t NUM_WINDOWS = 16;
+  // differences are taken in integers, the times are too large for
+  // double precision
+  int64_t predict(uint64_t cameraTime) const
+  {
+    const double dt = static_cast<double>(
+      static_cast<int64_t>(cameraTime) - static_cast<int64_t>(origin_));
+    return (offset_ + static_cast<int64_t>(std::llround(slope_ * dt)));
+  }
+  void fit();
+  // ----- variables --
+  struct Point
+  {
+    uint64_t cameraTime;
+    int64_t offset;  // host time - camera time
+  };
+  std::array<Point, NUM_WINDOWS> points_;
+  size_t numPoints_{0};
+  size_t nextPoint_{0};
+  uint64_t lastCameraTime_{0};
+  uint64_t windowStart_{0};
+  Point windowMin_{0, 0};
+  bool windowEmpty_{true};
+  // the fitted line: offset_ at camera time origin_, changing by slope_
+  uint64_t origin_{0};
+  int64_t offset_{0};
+  double slope_{0};
+  bool haveFit_{false};
+  std::atomic<double> drift_{0};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // CLOCK_ESTIMATOR_H_
@@ -0,0 +1,295 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "config_cache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+static const char FILE_HEADER[] = "# flir_spinnaker_common config cache 1";
+
+static std::string bare_name(const std::string & nodeName)
+{
+  const auto pos = nodeName.rfind('/');
+  return (pos == std::string::npos ? nodeName : nodeName.substr(pos + 1));
+}
+
+// firmware versions can contain anything
+static std::string to_file_name(const std::string & s)
+{
+  std::string f(s);
+  for (auto & c : f) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') {
+      c = '_';
+    }
+  }
+  return (f);
+}
+
+static const char * type_to_string(Driver::ParameterType t)
+{
+  switch (t) {
+    case Driver::ENUM:
+      return ("enum");
+    case Driver::DOUBLE:
+      return ("double");
+    case Driver::INT:
+      return ("int");
+    case Driver::BOOL:
+      return ("bool");
+  }
+  return ("unknown");
+}
+
+static bool string_to_type(const std::string & s, Driver::ParameterType * t)
+{
+  static const Driver::ParameterType types[] = {
+    Driver::ENUM, Driver::DOUBLE, Driver::INT, Driver::BOOL};
+  for (const auto type : types) {
+    if (s == type_to_string(type)) {
+      *t = type;
+      return (true);
+    }
+  }
+  return (false);
+}
+
+static void write_value(std::ostream & os, const Driver::Parameter & p)
+{
+  switch (p.type) {
+    case Driver::ENUM:
+      os << p.enumValue;
+      break;
+    case Driver::DOUBLE:
+      // must read back to the identical value
+      os << std::setprecision(std::numeric_limits<double>::max_digits10)
+         << p.doubleValue;
+      break;
+    case Driver::INT:
+      os << p.intValue;
+      break;
+    case Driver::BOOL:
+      os << (p.boolValue ? 1 : 0);
+      break;
+  }
+}
+
+static bool read_value(std::istream & is, Driver::Parameter * p)
+{
+  switch (p->type) {
+    case Driver::ENUM:
+      is >> p->enumValue;
+      break;
+    case Driver::DOUBLE:
+      is >> p->doubleValue;
+      break;
+    case Driver::INT:
+      is >> p->intValue;
+      break;
+    case Driver::BOOL:
+      is >> p->boolValue;
+      break;
+  }
+  return (!is.fail());
+}
+
+static bool same_value(const Driver::Parameter & a, const Driver::Parameter & b)
+{
+  if (a.type != b.type) {
+    return (false);
+  }
+  switch (a.type) {
+    case Driver::ENUM:
+      return (a.enumValue == b.enumValue);
+    case Driver::DOUBLE:
+      return (a.doubleValue == b.doubleValue);
+    case Driver::INT:
+      return (a.intValue == b.intValue);
+    case Driver::BOOL:
+      return (a.boolValue == b.boolValue);
+  }
+  return (false);
+}
+
+ConfigCache::ConfigCache(
+  const std::string & directory, const std::string & serialNumber,
+  const std::string & firmwareVersion)
+: path_(
+    directory + "/" + to_file_name(serialNumber) + "_" +
+    to_file_name(firmwareVersion))
+{
+}
+
+bool ConfigCache::load()
+{
+  entries_.clear();
+  userSet_.clear();
+  modified_ = false;
+  if (!isPersistent()) {
+    return (false);
+  }
+  std::ifstream in(path_ + ".cfg");
+  std::string line;
+  if (!in.is_open() || !std::getline(in, line) || line != FILE_HEADER) {
+    return (false);
+  }
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    std::string key, type;
+    is >> key;
+    if (key == "userset") {
+      is >> userSet_;
+      continue;
+    }
+    Entry e;
+    if (
+      key != "param" || !(is >> e.requested.name >> type) ||
+      !string_to_type(type, &e.requested.type)) {
+      std::cerr << "ignoring bad config cache line: " << line << std::endl;
+      continue;
+    }
+    e.actual.name = e.requested.name;
+    e.actual.type = e.requested.type;
+    if (read_value(is, &e.requested) && read_value(is, &e.actual)) {
+      entries_[bare_name(e.requested.name)] = e;
+    }
+  }
+  return (true);
+}
+
+bool ConfigCache::save()
+{
+  if (!modified_ || !isPersistent()) {
+    return (true);
+  }
+  // write and rename, so a crash cannot leave a truncated file
+  const std::string tmpFile = path_ + ".cfg.tmp";
+  {
+    std::ofstream out(tmpFile);
+    if (!out.is_open()) {
+      std::cerr << "cannot write config cache " << tmpFile << std::endl;
+      return (false);
+    }
+    out << FILE_HEADER << std::endl;
+    if (!userSet_.empty()) {
+      out << "userset " << userSet_ << std::endl;
+    }
+    for (const auto & kv : entries_) {
+      const Entry & e = kv.second;
+      out << "param " << e.requested.name << " "
+          << type_to_string(e.requested.type) << " ";
+      write_value(out, e.requested);
+      out << " ";
+      write_value(out, e.actual);
+      out << std::endl;
+    }
+    if (!out.good()) {
+      return (false);
+    }
+  }
+  if (std::rename(tmpFile.c_str(), (path_ + ".cfg").c_str()) != 0) {
+    std::cerr << "cannot rename config cache " << tmpFile << std::endl;
+    return (false);
+  }
+  modified_ = false;
+  return (true);
+}
+
+bool ConfigCache::find(
+  const Driver::Parameter & p, Driver::Parameter * actual) const
+{
+  const auto it = entries_.find(bare_name(p.name));
+  if (it == entries_.end() || !same_value(it->second.requested, p)) {
+    return (false);
+  }
+  *actual = it->second.actual;
+  actual->name = p.name;
+  return (true);
+}
+
+void ConfigCache::update(
+  const Driver::Parameter & p, const Driver::Parameter & actual)
+{
+  Entry & e = entries_[bare_name(p.name)];
+  if (
+    e.requested.name == p.name && same_value(e.requested, p) &&
+    same_value(e.actual, actual)) {
+    return;
+  }
+  e.requested = p;
+  e.actual = actual;
+  e.actual.name = p.name;
+  modified_ = true;
+}
+
+void ConfigCache::erase(const std::string & nodeName)
+{
+  if (entries_.erase(bare_name(nodeName)) > 0) {
+    modified_ = true;
+  }
+}
+
+std::vector<Driver::Parameter> ConfigCache::getParameters() const
+{
+  std::vector<Driver::Parameter> params;
+  for (const auto & kv : entries_) {
+    params.push_back(kv.second.requested);
+  }
+  return (params);
+}
+
+void ConfigCache::setUserSet(const std::string & userSet)
+{
+  if (userSet != userSet_) {
+    userSet_ = userSet;
+    modified_ = true;
+  }
+}
+
+bool ConfigCache::loadNodeMap(std::string * nodeMap) const
+{
+  if (!isPersistent()) {
+    return (false);
+  }
+  std::ifstream in(path_ + ".xml");
+  if (!in.is_open()) {
+    return (false);
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  *nodeMap = ss.str();
+  return (!nodeMap->empty());
+}
+
+bool ConfigCache::saveNodeMap(const std::string & nodeMap) const
+{
+  if (!isPersistent()) {
+    return (true);
+  }
+  std::ofstream out(path_ + ".xml");
+  out << nodeMap;
+  return (out.good());
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,78 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CONFIG_CACHE_H_
+#define CONFIG_CACHE_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+//
+// The parameters applied to one camera, kept in a file named after
+// its serial number and firmware version. Each entry holds the value
+// that was requested and the value the camera ended up with, so that
+// a request for the same value can be answered without touching the
+// camera. Nodes are keyed by their bare name. The node map description
+// depends only on the firmware and is kept in a second file. Without
+// a file, the cache only remembers the parameters in memory.
+// Not thread safe.
+//
+class ConfigCache
+{
+public:
+  ConfigCache() = default;  // no file
+  ConfigCache(
+    const std::string & directory, const std::string & serialNumber,
+    const std::string & firmwareVersion);
+  // returns false if there is no valid cache file
+  bool load();
+  // writes the file if anything changed, returns false on failure
+  bool save();
+  // true if the parameter was applied before with the same value
+  bool find(const Driver::Parameter & p, Driver::Parameter * actual) const;
+  void update(const Driver::Parameter & p, const Driver::Parameter & actual);
+  void erase(const std::string & nodeName);
+  // the user set holding the cached values, empty if none
+  const std::string & getUserSet() const { return (userSet_); }
+  void setUserSet(const std::string & userSet);
+  bool isModified() const { return (modified_); }
+  bool isPersistent() const { return (!path_.empty()); }
+  size_t size() const { return (entries_.size()); }
+  // the requested values
+  std::vector<Driver::Parameter> getParameters() const;
+  bool loadNodeMap(std::string * nodeMap) const;
+  bool saveNodeMap(const std::string & nodeMap) const;
+
+private:
+  struct Entry
+  {
+    Driver::Parameter requested;
+    Driver::Parameter actual;
+  };
+  // ----- variables --
+  std::string path_;  // without extension
+  std::map<std::string, Entry> entries_;
+  std::string userSet_;
+  bool modified_{false};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // CONFIG_CACHE_H_
@@ -0,0 +1,512 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/debayer.h>
+#include <flir_spinnaker_common/unpack.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "thread_pool.h"
+
+namespace flir_spinnaker_common
+{
+namespace debayer
+{
+using pixel_format::PixelFormat;
+
+// rows per band, small enough for the scratch buffers to stay in cache
+static const long BAND_ROWS = 16;
+// mirrored border around the raw data, the edge aware method needs 3
+static const long PAD = 3;
+// the row kernels may run past the end of a row by this many pixels
+static const long MAX_LANES = 8;
+
+struct CfaInfo
+{
+  bool ok;
+  int rx;  // column of red in the 2x2 pattern
+  int ry;  // row of red in the 2x2 pattern
+  int bitDepth;
+  bool isPacked;
+};
+
+static constexpr CfaInfo get_cfa(const pixel_format::Traits & t)
+{
+  return {
+    t.cfa != pixel_format::NO_CFA,
+    (t.cfa == pixel_format::CFA_GR || t.cfa == pixel_format::CFA_BG) ? 1 : 0,
+    (t.cfa == pixel_format::CFA_GB || t.cfa == pixel_format::CFA_BG) ? 1 : 0,
+    t.bitDepth, t.packing != pixel_format::UNPACKED};
+}
+
+static CfaInfo get_cfa(PixelFormat pf)
+{
+  return (get_cfa(pixel_format::get_traits(pf)));
+}
+
+static long mirror(long i, long n)
+{
+  if (i < 0) {
+    i = -i;
+  }
+  if (i >= n) {
+    i = 2 * n - 2 - i;
+  }
+  return (std::min(std::max(i, 0L), n - 1));
+}
+
+//
+// Scratch space for one band of rows. The raw data is widened to 32
+// bit and surrounded by a mirrored border, so the interpolation loops
+// need no bounds checks. Rows are long enough for the kernels to
+// process whole vectors, the lanes past the end are discarded.
+//
+struct Band
+{
+  Band(long width, long height)
+  : w(width),
+    h(height),
+    pw(width + 2 * PAD + MAX_LANES),
+    raw((BAND_ROWS + 2 * PAD) * pw),
+    green((BAND_ROWS + 2) * pw),
+    rgb(3 * (width + MAX_LANES))
+  {
+  }
+  int32_t * rawRow(long y) { return (&raw[(y - y0 + PAD) * pw + PAD]); }
+  // green has one row of border above and below
+  int32_t * greenRow(long y) { return (&green[(y - y0 + 1) * pw + PAD]); }
+  // one output row, as separate red, green and blue planes
+  int32_t * plane(int i) { return (&rgb[i * (w + MAX_LANES)]); }
+
+  long w;
+  long h;
+  long pw;
+  long y0{0};
+  long y1{0};
+  std::vector<int32_t> raw;
+  std::vector<int32_t> green;
+  std::vector<int32_t> rgb;
+};
+
+template <class T>
+static void load_band(const uint8_t * src, size_t stride, Band * b)
+{
+  const long w = b->w;
+  for (long y = b->y0 - PAD; y < b->y1 + PAD; y++) {
+    const T * s = reinterpret_cast<const T *>(src + mirror(y, b->h) * stride);
+    int32_t * d = b->rawRow(y);
+    for (long x = 0; x < w; x++) {
+      d[x] = s[x];
+    }
+    for (long x = 1; x <= PAD; x++) {
+      d[-x] = d[mirror(-x, w)];
+      d[w - 1 + x] = d[mirror(w - 1 + x, w)];
+    }
+  }
+}
+
+// ------------- row kernels
+//
+// Written once with GCC vector extensions and instantiated for 1
+// (scalar), 4 (SSE2, NEON) and 8 (AVX2) lanes of 32 bit. Every pixel
+// computes the values for both a chroma and a green site, the column
+// parity selects between them. All loads and stores are unit stride.
+// The helpers must be inlined into the per instruction set wrappers,
+// which determine the code generated for them.
+//
+typedef int32_t Vec1 __attribute__((vector_size(4)));
+typedef int32_t Vec4 __attribute__((vector_size(16)));
+typedef int32_t Vec8 __attribute__((vector_size(32)));
+
+#define DEBAYER_INLINE __attribute__((always_inline)) static inline
+
+// AVX2 vectors are passed between functions compiled for SSE2, but
+// only before they are all inlined into the AVX2 wrappers. The warning
+// is issued at the end of the file, so it cannot be scoped.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+template <class V>
+DEBAYER_INLINE V load(const int32_t * p)
+{
+  V v;
+  memcpy(&v, p, sizeof(V));
+  return (v);
+}
+
+template <class V>
+DEBAYER_INLINE void store(int32_t * p, const V & v)
+{
+  memcpy(p, &v, sizeof(V));
+}
+
+// lanes where the mask is all ones take a, the others b
+template <class V>
+DEBAYER_INLINE V select(const V & mask, const V & a, const V & b)
+{
+  return ((mask & a) | (~mask & b));
+}
+
+template <class V>
+DEBAYER_INLINE V abs(const V & v)
+{
+  const V sign = v >> 31;
+  return ((v ^ sign) - sign);
+}
+
+// division by 2 and 4 that rounds towards zero, like the / operator
+template <class V>
+DEBAYER_INLINE V div2(const V & v)
+{
+  return ((v + ((v >> 31) & 1)) >> 1);
+}
+
+template <class V>
+DEBAYER_INLINE V div4(const V & v)
+{
+  return ((v + ((v >> 31) & 3)) >> 2);
+}
+
+template <class V>
+DEBAYER_INLINE V clamp(const V & v, const V & maxVal)
+{
+  const V zero = V{};
+  const V lo = select(V(v < zero), zero, v);
+  return (select(V(lo > maxVal), maxVal, lo));
+}
+
+// all ones in the lanes of the columns x, x + 1, ... that have parity p
+template <class V>
+DEBAYER_INLINE V parity_mask(long x, int p)
+{
+  V lane;
+  for (size_t i = 0; i < sizeof(V) / sizeof(int32_t); i++) {
+    lane[i] = static_cast<int32_t>(x + static_cast<long>(i));
+  }
+  return (V((lane & 1) == p));
+}
+
+// ci: index of the color at the non-green sites of this row, cp: their
+// column parity
+template <class V>
+DEBAYER_INLINE void bilinear_row(Band * b, long y, int ci, int cp)
+{
+  const long n = sizeof(V) / sizeof(int32_t);
+  const int32_t * nr = b->rawRow(y - 1);
+  const int32_t * cr = b->rawRow(y);
+  const int32_t * sr = b->rawRow(y + 1);
+  int32_t * oc = b->plane(ci);
+  int32_t * og = b->plane(1);
+  int32_t * oo = b->plane(2 - ci);  // the other color
+  for (long x = 0; x < b->w; x += n) {
+    const V m = parity_mask<V>(x, cp);
+    const V c = load<V>(cr + x);
+    const V cl = load<V>(cr + x - 1);
+    const V cR = load<V>(cr + x + 1);
+    const V no = load<V>(nr + x);
+    const V so = load<V>(sr + x);
+    const V diag = load<V>(nr + x - 1) + load<V>(nr + x + 1) +
+                   load<V>(sr + x - 1) + load<V>(sr + x + 1);
+    store(oc + x, select(m, c, (cl + cR + 1) >> 1));
+    store(og + x, select(m, (no + so + cl + cR + 2) >> 2, c));
+    store(oo + x, select(m, (diag + 2) >> 2, (no + so + 1) >> 1));
+  }
+}
+
+// green at the chroma sites, interpolated along the smaller gradient
+// with a second order correction from the chroma channel
+template <class V>
+DEBAYER_INLINE void green_row(Band * b, long y, int cp, int32_t maxVal)
+{
+  const long n = sizeof(V) / sizeof(int32_t);
+  const V vmax = V{} + maxVal;
+  const int32_t * nnr = b->rawRow(y - 2);
+  const int32_t * nr = b->rawRow(y - 1);
+  const int32_t * cr = b->rawRow(y);
+  const int32_t * sr = b->rawRow(y + 1);
+  const int32_t * ssr = b->rawRow(y + 2);
+  int32_t * g = b->greenRow(y);
+  // includes the border columns -1 and w
+  for (long x = -1; x <= b->w; x += n) {
+    const V c = load<V>(cr + x);
+    const V cl = load<V>(cr + x - 1);
+    const V cR = load<V>(cr + x + 1);
+    const V no = load<V>(nr + x);
+    const V so = load<V>(sr + x);
+    const V lh = 2 * c - load<V>(cr + x - 2) - load<V>(cr + x + 2);
+    const V lv = 2 * c - load<V>(nnr + x) - load<V>(ssr + x);
+    const V dh = abs(cl - cR) + abs(lh);
+    const V dv = abs(no - so) + abs(lv);
+    const V gh = div4(2 * (cl + cR) + lh);
+    const V gv = div4(2 * (no + so) + lv);
+    const V gi =
+      select(V(dh < dv), gh, select(V(dv < dh), gv, div2(gh + gv)));
+    store(g + x, select(parity_mask<V>(x, cp), clamp(gi, vmax), c));
+  }
+}
+
+template <class V>
+DEBAYER_INLINE void edge_aware_row(
+  Band * b, long y, int ci, int cp, int32_t maxVal)
+{
+  const long n = sizeof(V) / sizeof(int32_t);
+  const V vmax = V{} + maxVal;
+  const int32_t * nr = b->rawRow(y - 1);
+  const int32_t * cr = b->rawRow(y);
+  const int32_t * sr = b->rawRow(y + 1);
+  const int32_t * gnr = b->greenRow(y - 1);
+  const int32_t * gcr = b->greenRow(y);
+  const int32_t * gsr = b->greenRow(y + 1);
+  int32_t * oc = b->plane(ci);
+  int32_t * og = b->plane(1);
+  int32_t * oo = b->plane(2 - ci);
+  for (long x = 0; x < b->w; x += n) {
+    const V m = parity_mask<V>(x, cp);
+    const V c = load<V>(cr + x);
+    const V gc = load<V>(gcr + x);
+    // color differences to green: diagonal, horizontal, vertical
+    const V d = (load<V>(nr + x - 1) - load<V>(gnr + x - 1)) +
+                (load<V>(nr + x + 1) - load<V>(gnr + x + 1)) +
+                (load<V>(sr + x - 1) - load<V>(gsr + x - 1)) +
+                (load<V>(sr + x + 1) - load<V>(gsr + x + 1));
+    const V dh = (load<V>(cr + x - 1) - load<V>(gcr + x - 1)) +
+                 (load<V>(cr + x + 1) - load<V>(gcr + x + 1));
+    const V dv = (load<V>(nr + x) - load<V>(gnr + x)) +
+                 (load<V>(sr + x) - load<V>(gsr + x));
+    store(oc + x, select(m, c, clamp(c + div2(dh), vmax)));
+    store(og + x, select(m, gc, c));
+    store(
+      oo + x,
+      select(m, clamp(gc + div4(d), vmax), clamp(c + div2(dv), vmax)));
+  }
+}
+
+typedef void (*BilinearRowFunction)(Band * b, long y, int ci, int cp);
+typedef void (*GreenRowFunction)(Band * b, long y, int cp, int32_t maxVal);
+typedef void (*EdgeAwareRowFunction)(
+  Band * b, long y, int ci, int cp, int32_t maxVal);
+struct Kernels
+{
+  BilinearRowFunction bilinearRow;
+  GreenRowFunction greenRow;
+  EdgeAwareRowFunction edgeAwareRow;
+  const char * name;
+};
+
+// instantiates the kernels for vector type V with the given attributes
+#define DEBAYER_KERNELS(isa, V, attr)                                      \
+  attr static void bilinear_row_##isa(Band * b, long y, int ci, int cp)    \
+  {                                                                        \
+    bilinear_row<V>(b, y, ci, cp);                                         \
+  }                                                                        \
+  attr static void green_row_##isa(Band * b, long y, int cp, int32_t mx)   \
+  {                                                                        \
+    green_row<V>(b, y, cp, mx);                                            \
+  }                                                                        \
+  attr static void edge_aware_row_##isa(                                   \
+    Band * b, long y, int ci, int cp, int32_t mx)                          \
+  {                                                                        \
+    edge_aware_row<V>(b, y, ci, cp, mx);                                   \
+  }                                                                        \
+  static const Kernels isa##_kernels                                       \
+  {                                                                        \
+    bilinear_row_##isa, green_row_##isa, edge_aware_row_##isa, #isa        \
+  }
+
+DEBAYER_KERNELS(scalar, Vec1, );
+#if defined(__x86_64__)
+#define DEBAYER_HAS_X86
+DEBAYER_KERNELS(sse2, Vec4, );
+DEBAYER_KERNELS(avx2, Vec8, __attribute__((target("avx2"))));
+#elif defined(__aarch64__)
+DEBAYER_KERNELS(neon, Vec4, );
+#endif
+
+// null if the CPU does not support the instruction set
+static const Kernels * find_kernels(const char * name)
+{
+#ifdef DEBAYER_HAS_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+    return (&avx2_kernels);
+  }
+  if (!strcmp(name, "sse2")) {
+    return (&sse2_kernels);
+  }
+#elif defined(__aarch64__)
+  if (!strcmp(name, "neon")) {
+    return (&neon_kernels);
+  }
+#endif
+  return (!strcmp(name, "scalar") ? &scalar_kernels : nullptr);
+}
+
+static const Kernels * select_kernels()
+{
+  for (const char * name : {"avx2", "sse2", "neon"}) {
+    const Kernels * k = find_kernels(name);
+    if (k) {
+      return (k);
+    }
+  }
+  return (&scalar_kernels);
+}
+
+static std::atomic<const Kernels *> & current_kernels()
+{
+  static std::atomic<const Kernels *> kernels{select_kernels()};
+  return (kernels);
+}
+
+static void write_row(Band * b, int bitDepth, OutputFormat f, uint8_t * dst)
+{
+  const long w = b->w;
+  const int32_t * r = b->plane(0);
+  const int32_t * g = b->plane(1);
+  const int32_t * bl = b->plane(2);
+  switch (f) {
+    case RGB8: {
+      const int sh = bitDepth - 8;
+      for (long x = 0; x < w; x++) {
+        dst[3 * x] = static_cast<uint8_t>(r[x] >> sh);
+        dst[3 * x + 1] = static_cast<uint8_t>(g[x] >> sh);
+        dst[3 * x + 2] = static_cast<uint8_t>(bl[x] >> sh);
+      }
+      break;
+    }
+    case BGR8: {
+      const int sh = bitDepth - 8;
+      for (long x = 0; x < w; x++) {
+        dst[3 * x] = static_cast<uint8_t>(bl[x] >> sh);
+        dst[3 * x + 1] = static_cast<uint8_t>(g[x] >> sh);
+        dst[3 * x + 2] = static_cast<uint8_t>(r[x] >> sh);
+      }
+      break;
+    }
+    case RGB16: {
+      const int sh = 16 - bitDepth;
+      uint16_t * d = reinterpret_cast<uint16_t *>(dst);
+      for (long x = 0; x < w; x++) {
+        d[3 * x] = static_cast<uint16_t>(r[x] << sh);
+        d[3 * x + 1] = static_cast<uint16_t>(g[x] << sh);
+        d[3 * x + 2] = static_cast<uint16_t>(bl[x] << sh);
+      }
+      break;
+    }
+  }
+}
+
+static void process_band(
+  const Kernels & k, const CfaInfo & cfa, const uint8_t * src,
+  size_t srcStride, bool is16Bit, uint8_t * dst, size_t dstStride,
+  OutputFormat outFmt, Method method, Band * b)
+{
+  if (is16Bit) {
+    load_band<uint16_t>(src, srcStride, b);
+  } else {
+    load_band<uint8_t>(src, srcStride, b);
+  }
+  const int32_t maxVal = (1 << cfa.bitDepth) - 1;
+  if (method == EDGE_AWARE) {
+    for (long y = b->y0 - 1; y < b->y1 + 1; y++) {
+      const bool redRow = ((y & 1) == cfa.ry);
+      k.greenRow(b, y, redRow ? cfa.rx : 1 - cfa.rx, maxVal);
+    }
+  }
+  for (long y = b->y0; y < b->y1; y++) {
+    const bool redRow = ((y & 1) == cfa.ry);
+    const int ci = redRow ? 0 : 2;
+    const int cp = redRow ? cfa.rx : 1 - cfa.rx;
+    if (method == EDGE_AWARE) {
+      k.edgeAwareRow(b, y, ci, cp, maxVal);
+    } else {
+      k.bilinearRow(b, y, ci, cp);
+    }
+    write_row(b, cfa.bitDepth, outFmt, dst + y * dstStride);
+  }
+}
+
+bool is_supported(PixelFormat pf) { return (get_cfa(pf).ok); }
+
+bool debayer(
+  PixelFormat pf, const void * src, size_t w, size_t h, size_t srcStride,
+  void * dst, size_t dstStride, OutputFormat outFmt, Method method,
+  int numThreads)
+{
+  static std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>(4);
+  const CfaInfo cfa = get_cfa(pf);
+  if (!cfa.ok || w < 4 || h < 4 || !src || !dst) {
+    return (false);
+  }
+  const uint8_t * s = static_cast<const uint8_t *>(src);
+  size_t ss = srcStride;
+  std::shared_ptr<uint8_t> unpacked;
+  if (cfa.isPacked) {
+    ss = w * sizeof(uint16_t);
+    unpacked = pool->get(ss * h);
+    unpack::unpack(
+      pf, s, w, h, srcStride, reinterpret_cast<uint16_t *>(unpacked.get()), ss,
+      numThreads);
+    s = unpacked.get();
+  }
+  const bool is16Bit = cfa.bitDepth > 8;
+  const Kernels & k = *current_kernels().load(std::memory_order_relaxed);
+  const size_t numBands = (h + BAND_ROWS - 1) / BAND_ROWS;
+  uint8_t * d = static_cast<uint8_t *>(dst);
+  ThreadPool::getProcessingPool().parallelFor(
+    numBands, 1, numThreads, [&](size_t begin, size_t end) {
+      Band band(static_cast<long>(w), static_cast<long>(h));
+      for (size_t i = begin; i < end; i++) {
+        band.y0 = static_cast<long>(i) * BAND_ROWS;
+        band.y1 = std::min(band.y0 + BAND_ROWS, static_cast<long>(h));
+        process_band(
+          k, cfa, s, ss, is16Bit, d, dstStride, outFmt, method, &band);
+      }
+    });
+  return (true);
+}
+
+bool debayer(
+  const Image & img, void * dst, size_t dstStride, OutputFormat outFmt,
+  Method method, int numThreads)
+{
+  return (debayer(
+    img.pixelFormat_, img.data_, img.width_, img.height_, img.stride_, dst,
+    dstStride, outFmt, method, numThreads));
+}
+
+const char * get_instruction_set()
+{
+  return (current_kernels().load(std::memory_order_relaxed)->name);
+}
+
+bool set_instruction_set(const char * name)
+{
+  const Kernels * k = find_kernels(name);
+  if (k) {
+    current_kernels().store(k, std::memory_order_relaxed);
+  }
+  return (k != nullptr);
+}
+}  // namespace debayer
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,154 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "delivery_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+namespace flir_spinnaker_common
+{
+// upper bound on sleeping, guards against missed notifications
+static const std::chrono::milliseconds MAX_WAIT(100);
+
+// The queue positions are updated with relaxed atomics. The fences
+// order them against numWaiting_: either the waker sees the sleeper
+// registered, or the sleeper sees the new queue state when it checks
+// its predicate under the mutex.
+static inline void fence()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+DeliveryQueue::DeliveryQueue(
+  const Driver::DeliveryConfig & config, const Driver::Callback & cb)
+: config_(config), callback_(cb), queue_(config.queueSize)
+{
+  const int n = std::max(config_.numThreads, 1);
+  for (int i = 0; i < n; i++) {
+    threads_.emplace_back(&DeliveryQueue::run, this);
+  }
+}
+
+DeliveryQueue::~DeliveryQueue() { stop(); }
+
+void DeliveryQueue::push(const ImageConstPtr & img)
+{
+  if (!keepRunning_) {
+    return;
+  }
+  ImageConstPtr im = img;
+  while (!queue_.tryPush(std::move(im))) {
+    if (!keepRunning_) {
+      return;
+    }
+    switch (config_.overflowPolicy) {
+      case Driver::DROP_NEWEST:
+        numDropped_++;
+        return;
+      case Driver::DROP_OLDEST: {
+        ImageConstPtr oldest;
+        if (queue_.tryPop(&oldest)) {
+          numDropped_++;
+        }
+        break;
+      }
+      case Driver::BLOCK: {
+        std::unique_lock<std::mutex> lock(mutex_);
+        numWaiting_++;
+        fence();
+        notFull_.wait_for(lock, MAX_WAIT, [this] {
+          return (queue_.size() < queue_.capacity() || !keepRunning_);
+        });
+        numWaiting_--;
+        break;
+      }
+    }
+    im = img;  // tryPush() may have moved from it
+  }
+  fence();
+  if (numWaiting_ > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notEmpty_.notify_one();
+  }
+}
+
+void DeliveryQueue::run()
+{
+  while (keepRunning_) {
+    ImageConstPtr img;
+    if (queue_.tryPop(&img)) {
+      fence();
+      if (numWaiting_ > 0) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.notify_all();  // producer and drain() may both wait
+      }
+      try {
+        callback_(img);
+      } catch (const std::exception & e) {
+        std::cerr << "image callback failed: " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "image callback failed!" << std::endl;
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(mutex_);
+      numWaiting_++;
+      fence();
+      notEmpty_.wait_for(lock, MAX_WAIT, [this] {
+        return (queue_.size() > 0 || !keepRunning_);
+      });
+      numWaiting_--;
+    }
+  }
+}
+
+bool DeliveryQueue::drain(std::chrono::nanoseconds maxWait)
+{
+  const auto deadline = std::chrono::steady_clock::now() + maxWait;
+  std::unique_lock<std::mutex> lock(mutex_);
+  numWaiting_++;  // makes the workers notify after every pop
+  fence();
+  while (queue_.size() > 0 && keepRunning_ &&
+         std::chrono::steady_clock::now() < deadline) {
+    notFull_.wait_until(
+      lock, std::min(deadline, std::chrono::steady_clock::now() + MAX_WAIT));
+  }
+  numWaiting_--;
+  return (queue_.size() == 0);
+}
+
+size_t DeliveryQueue::stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+  for (auto & th : threads_) {
+    th.join();
+  }
+  threads_.clear();
+  size_t numDiscarded = 0;
+  ImageConstPtr img;
+  while (queue_.tryPop(&img)) {
+    img.reset();  // returns the buffer to the stream
+    numDiscarded++;
+  }
+  return (numDiscarded);
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,70 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DELIVERY_QUEUE_H_
+#define DELIVERY_QUEUE_H_
+
+#include <flir_spinnaker_common/driver.h>
+#include <flir_spinnaker_common/image.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+
+namespace flir_spinnaker_common
+{
+//
+// Hands images from the acquisition thread to the user callback,
+// which runs on a set of dedicated worker threads.
+//
+class DeliveryQueue
+{
+public:
+  DeliveryQueue(
+    const Driver::DeliveryConfig & config, const Driver::Callback & cb);
+  ~DeliveryQueue();
+  // called from the acquisition thread
+  void push(const ImageConstPtr & img);
+  // Joins the workers and discards all frames that are still queued.
+  // Returns the number of frames discarded.
+  size_t stop();
+  // Waits for the workers to take all queued frames, at most maxWait.
+  // Returns false if there are frames left.
+  bool drain(std::chrono::nanoseconds maxWait);
+  size_t getDepth() const { return (queue_.size()); }
+  uint64_t getNumDropped() const { return (numDropped_); }
+
+private:
+  void run();
+  // ----- variables --
+  Driver::DeliveryConfig config_;
+  Driver::Callback callback_;
+  FrameQueue<ImageConstPtr> queue_;
+  std::atomic<bool> keepRunning_{true};
+  std::atomic<uint64_t> numDropped_{0};
+  std::atomic<int> numWaiting_{0};  // workers and producer sleeping
+  std::mutex mutex_;  // only used for sleeping, not for the queue
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::vector<std::thread> threads_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // DELIVERY_QUEUE_H_
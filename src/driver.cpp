@@ -13,7 +13,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#ifdef HAVE_SPINNAKER
 #include <Spinnaker.h>
+#endif
 #include <flir_spinnaker_common/driver.h>
 
 #include <string>
@@ -22,6 +24,21 @@
 
 namespace flir_spinnaker_common
 {
+// Spinnaker exceptions are passed on as DriverException
+template <class F>
+static auto translate_exceptions(const F & f) -> decltype(f())
+{
+#ifdef HAVE_SPINNAKER
+  try {
+    return (f());
+  } catch (const Spinnaker::Exception & e) {
+    throw Driver::DriverException(e.what());
+  }
+#else
+  return (f());
+#endif
+}
+
 Driver::Driver() { driverImpl_.reset(new DriverImpl()); }
 
 std::string Driver::getLibraryVersion() const
@@ -41,11 +58,21 @@ bool Driver::initCamera(const std::string & serialNumber)
   return driverImpl_->initCamera(serialNumber);
 }
 
+bool Driver::initSyntheticCamera(const SyntheticCameraConfig & config)
+{
+  return driverImpl_->initSyntheticCamera(config);
+}
+
 bool Driver::deInitCamera() { return driverImpl_->deInitCamera(); }
 
 bool Driver::startCamera(const Callback & cb)
 {
-  return driverImpl_->startCamera(cb);
+  return driverImpl_->startCamera(cb, DeliveryConfig());
+}
+
+bool Driver::startCamera(const Callback & cb, const DeliveryConfig & dc)
+{
+  return driverImpl_->startCamera(cb, dc);
 }
 
 bool Driver::stopCamera() { return driverImpl_->stopCamera(); }
@@ -67,40 +94,41 @@ std::string Driver::getNodeMapAsString()
 std::string Driver::setEnum(
   const std::string & nodeName, const std::string & val, std::string * retVal)
 {
-  try {
-    return (driverImpl_->setEnum(nodeName, val, retVal));
-  } catch (const Spinnaker::Exception & e) {
-    throw DriverException(e.what());
-  }
+  return (translate_exceptions(
+    [&]() { return (driverImpl_->setEnum(nodeName, val, retVal)); }));
 }
 
 std::string Driver::setDouble(
   const std::string & nodeName, double val, double * retVal)
 {
-  try {
-    return (driverImpl_->setDouble(nodeName, val, retVal));
-  } catch (const Spinnaker::Exception & e) {
-    throw DriverException(e.what());
-  }
+  return (translate_exceptions(
+    [&]() { return (driverImpl_->setDouble(nodeName, val, retVal)); }));
+}
+
+std::vector<Driver::ParameterResult> Driver::setParameters(
+  const std::vector<Parameter> & params)
+{
+  return (driverImpl_->setParameters(params));
 }
 
+std::string Driver::setRoi(const Roi & roi, Roi * actual)
+{
+  return (driverImpl_->setRoi(roi, actual));
+}
+
+bool Driver::getRoi(Roi * roi) { return (driverImpl_->getRoi(roi)); }
+
 std::string Driver::setBool(
   const std::string & nodeName, bool val, bool * retVal)
 {
-  try {
-    return (driverImpl_->setBool(nodeName, val, retVal));
-  } catch (const Spinnaker::Exception & e) {
-    throw DriverException(e.what());
-  }
+  return (translate_exceptions(
+    [&]() { return (driverImpl_->setBool(nodeName, val, retVal)); }));
 }
 
 std::string Driver::setInt(const std::string & nodeName, int val, int * retVal)
 {
-  try {
-    return (driverImpl_->setInt(nodeName, val, retVal));
-  } catch (const Spinnaker::Exception & e) {
-    throw DriverException(e.what());
-  }
+  return (translate_exceptions(
+    [&]() { return (driverImpl_->setInt(nodeName, val, retVal)); }));
 }
 
 void Driver::setComputeBrightness(bool b)
@@ -108,11 +136,71 @@ void Driver::setComputeBrightness(bool b)
   driverImpl_->setComputeBrightness(b);
 }
 
+void Driver::setBrightnessSkip(int skip)
+{
+  driverImpl_->setBrightnessSkip(skip);
+}
+
 void Driver::setAcquisitionTimeout(double t)
 {
   driverImpl_->setAcquisitionTimeout(t);
 }
 
+void Driver::setExposureControl(const ExposureControlConfig & config)
+{
+  driverImpl_->setExposureControl(config);
+}
+
+void Driver::setZeroCopy(bool b) { driverImpl_->setZeroCopy(b); }
+
+void Driver::setMaxHeldBuffers(int n) { driverImpl_->setMaxHeldBuffers(n); }
+
+void Driver::setStreamingConfig(const StreamingConfig & c)
+{
+  driverImpl_->setStreamingConfig(c);
+}
+
+void Driver::setAcquisitionThreadConfig(const AcquisitionThreadConfig & c)
+{
+  driverImpl_->setAcquisitionThreadConfig(c);
+}
+
+void Driver::setDeviceCallback(const DeviceCallback & cb)
+{
+  driverImpl_->setDeviceCallback(cb);
+}
+
+void Driver::setAutoReconnect(bool b) { driverImpl_->setAutoReconnect(b); }
+
+void Driver::setConfigCache(const ConfigCacheConfig & c)
+{
+  driverImpl_->setConfigCache(c);
+}
+
+bool Driver::saveConfigCache() { return (driverImpl_->saveConfigCache()); }
+
+Driver::Statistics Driver::getStatistics() const
+{
+  return (driverImpl_->getStatistics());
+}
+
+Driver::FrameDropStatistics Driver::getFrameDropStatistics() const
+{
+  return (translate_exceptions(
+    [&]() { return (driverImpl_->getFrameDropStatistics()); }));
+}
+
+void Driver::getImagePoolStatistics(uint64_t * hits, uint64_t * misses) const
+{
+  driverImpl_->getImagePoolStatistics(hits, misses);
+}
+
+void Driver::getDeliveryQueueStatistics(
+  size_t * depth, uint64_t * dropped) const
+{
+  driverImpl_->getDeliveryQueueStatistics(depth, dropped);
+}
+
 void Driver::setDebug(bool b) { driverImpl_->setDebug(b); }
 
 }  // namespace flir_spinnaker_common
@@ -15,410 +15,1017 @@
 
 #include "driver_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <numeric>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "genicam_utils.h"
+#include "brightness.h"
+#include "synthetic_camera.h"
+#ifdef HAVE_SPINNAKER
+#include "spinnaker_camera.h"
+#include "system_wrapper.h"
+#endif
 
 namespace flir_spinnaker_common
 {
 namespace chrono = std::chrono;
-namespace GenApi = Spinnaker::GenApi;
-namespace GenICam = Spinnaker::GenICam;
 
-template <class T>
-static bool is_available(T ptr)
+// room for the shared_ptr control block in front of the pooled image
+static const size_t IMAGE_POOL_BLOCK_OVERHEAD = 128;
+// one being filled, one ready and one spare
+static const int64_t LOW_LATENCY_BUFFERS = 3;
+// for the consumers to pick up the queued images before a stream restart
+static const chrono::milliseconds MAX_DRAIN_TIME(500);
+
+static uint64_t get_time()
 {
-  return (ptr.IsValid() && GenApi::IsAvailable(ptr));
+  return (chrono::duration_cast<chrono::nanoseconds>(
+            chrono::high_resolution_clock::now().time_since_epoch())
+            .count());
 }
 
-template <class T>
-static bool is_writable(T ptr)
+DriverImpl::DriverImpl() {}
+
+DriverImpl::~DriverImpl()
 {
-  return (ptr.IsValid() && GenApi::IsAvailable(ptr) && GenApi::IsWritable(ptr));
+  unwatchDevices();
+  stopCamera();
+  deInitCamera();
 }
 
-template <class T>
-static bool is_readable(T ptr)
+#ifdef HAVE_SPINNAKER
+std::shared_ptr<SystemWrapper> DriverImpl::getSystem() const
 {
-  return (ptr.IsValid() && GenApi::IsAvailable(ptr) && GenApi::IsReadable(ptr));
+  std::unique_lock<std::mutex> lock(systemMutex_);
+  if (!system_) {
+    system_ = SystemWrapper::getInstance();
+    // the camera list is shared between drivers, enumerate only once
+    if (!system_->hasCameraList()) {
+      system_->refreshCameraList();
+    }
+  }
+  return (system_);
 }
 
-static bool common_checks(
-  const GenApi::CNodePtr & np, const std::string & nodeName, std::string * msg)
+void DriverImpl::watchDevices()
 {
-  if (!np.IsValid()) {
-    *msg = "node " + nodeName + " does not exist!";
-    return (false);
+  std::shared_ptr<SystemWrapper> sys = getSystem();
+  std::unique_lock<std::mutex> lock(systemMutex_);
+  if (deviceCallbackId_ < 0) {
+    deviceCallbackId_ = sys->addDeviceCallback(
+      [this](const std::string & serial, bool arrived) {
+        onDeviceEvent(serial, arrived);
+      });
   }
-  if (!is_available(np)) {
-    *msg = "node " + nodeName + " not available!";
-    return (false);
+}
+
+void DriverImpl::unwatchDevices()
+{
+  std::shared_ptr<SystemWrapper> sys;
+  int id;
+  {
+    std::unique_lock<std::mutex> lock(systemMutex_);
+    sys = system_;
+    id = deviceCallbackId_;
+    deviceCallbackId_ = -1;
   }
-  if (!is_writable(np)) {
-    *msg = "node " + nodeName + " not available!";
-    return (false);
+  // waits for a running callback, which may call back into the driver
+  if (id >= 0) {
+    sys->removeDeviceCallback(id);
   }
-  return (true);
 }
 
-static std::string get_serial(Spinnaker::CameraPtr cam)
+void DriverImpl::refreshCameraList() { getSystem()->refreshCameraList(); }
+
+std::string DriverImpl::getLibraryVersion() const
 {
-  const auto & nodeMap = cam->GetTLDeviceNodeMap();
-  const Spinnaker::GenApi::CStringPtr psn =
-    nodeMap.GetNode("DeviceSerialNumber");
-  return is_readable(psn) ? std::string(psn->GetValue()) : "";
+  return (getSystem()->getLibraryVersion());
 }
 
-static bool set_acquisition_mode_continuous(GenApi::INodeMap & nodeMap)
+std::vector<std::string> DriverImpl::getSerialNumbers() const
 {
-  Spinnaker::GenApi::CEnumerationPtr ptrAcquisitionMode =
-    nodeMap.GetNode("AcquisitionMode");
-  if (
-    GenApi::IsAvailable(ptrAcquisitionMode) &&
-    GenApi::IsWritable(ptrAcquisitionMode)) {
-    GenApi::CEnumEntryPtr ptrAcquisitionModeContinuous =
-      ptrAcquisitionMode->GetEntryByName("Continuous");
-    if (
-      GenApi::IsAvailable(ptrAcquisitionModeContinuous) &&
-      GenApi::IsReadable(ptrAcquisitionModeContinuous)) {
-      // Retrieve integer value from entry node
-      const int64_t acquisitionModeContinuous =
-        ptrAcquisitionModeContinuous->GetValue();
-      // Set integer value from entry node as new value of enumeration node
-      ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
-      return true;
-    }
+  return (getSystem()->getSerialNumbers());
+}
+
+bool DriverImpl::initCamera(const std::string & serialNumber)
+{
+  watchDevices();
+  std::shared_ptr<SystemWrapper> sys = getSystem();
+  return (initCamera(serialNumber, [sys, serialNumber]() {
+    Spinnaker::CameraPtr cam = sys->findCamera(serialNumber);
+    return (
+      cam ? std::make_shared<SpinnakerCamera>(cam) : std::shared_ptr<Camera>());
+  }));
+}
+#else
+// built without the Spinnaker SDK: only the synthetic camera exists
+void DriverImpl::watchDevices() {}
+
+void DriverImpl::unwatchDevices() {}
+
+void DriverImpl::refreshCameraList() {}
+
+std::string DriverImpl::getLibraryVersion() const { return ("none"); }
+
+std::vector<std::string> DriverImpl::getSerialNumbers() const
+{
+  return (std::vector<std::string>());
+}
+
+bool DriverImpl::initCamera(const std::string & serialNumber)
+{
+  std::cerr << "driver: built without the Spinnaker SDK, cannot open camera "
+            << serialNumber << std::endl;
+  return (false);
+}
+#endif
+
+void DriverImpl::setDebug(bool b)
+{
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  debug_ = b;
+  if (camera_) {
+    camera_->setDebug(b);
   }
-  return false;
 }
 
-DriverImpl::DriverImpl()
+std::string DriverImpl::setEnum(
+  const std::string & nodeName, const std::string & val, std::string * retVal)
 {
-  system_ = Spinnaker::System::GetInstance();
-  if (!system_) {
-    std::cerr << "cannot instantiate spinnaker driver!" << std::endl;
-    throw std::runtime_error("failed to get spinnaker driver!");
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    *retVal = "UNKNOWN";
+    return ("node " + nodeName + " does not exist!");
   }
-  refreshCameraList();
+  const Driver::ParameterResult r =
+    applyParameter(Driver::Parameter(nodeName, val));
+  *retVal = r.value.enumValue;
+  return (r.message);
 }
 
-void DriverImpl::refreshCameraList()
+std::string DriverImpl::setDouble(
+  const std::string & nn, double val, double * retVal)
 {
-  cameraList_ = system_->GetCameras();
-  for (size_t cam_idx = 0; cam_idx < cameraList_.GetSize(); cam_idx++) {
-    const auto cam = cameraList_[cam_idx];
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    *retVal = std::nan("");
+    return ("node " + nn + " does not exist!");
   }
+  const Driver::ParameterResult r = applyParameter(Driver::Parameter(nn, val));
+  *retVal = r.value.doubleValue;
+  return (r.message);
 }
 
-DriverImpl::~DriverImpl()
+std::string DriverImpl::setBool(const std::string & nn, bool val, bool * retVal)
 {
-  keepRunning_ = false;
-  stopCamera();
-  deInitCamera();
-  camera_ = 0;  // call destructor, may not be needed
-  cameraList_.Clear();
-  if (system_) {
-    system_->ReleaseInstance();
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    *retVal = !val;
+    return ("node " + nn + " does not exist!");
   }
+  const Driver::ParameterResult r = applyParameter(Driver::Parameter(nn, val));
+  *retVal = r.value.boolValue;
+  return (r.message);
 }
 
-std::string DriverImpl::getLibraryVersion() const
+std::string DriverImpl::setInt(const std::string & nn, int val, int * retVal)
 {
-  const Spinnaker::LibraryVersion lv = system_->GetLibraryVersion();
-  char buf[256];
-  snprintf(
-    buf, sizeof(buf), "%d.%d.%d.%d", lv.major, lv.minor, lv.type, lv.build);
-  return std::string(buf);
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    *retVal = -1;
+    return ("node " + nn + " does not exist!");
+  }
+  const Driver::ParameterResult r = applyParameter(Driver::Parameter(nn, val));
+  *retVal = r.value.intValue;
+  return (r.message);
 }
 
-std::vector<std::string> DriverImpl::getSerialNumbers() const
+// Position of a node within a parameter batch. Nodes that change the
+// image geometry go first, since they change the limits of the nodes
+// that follow. Auto modes must be off before their values can be set.
+struct ParameterOrder
+{
+  int priority;
+  bool lockedWhileStreaming;
+};
+
+static const ParameterOrder DEFAULT_PARAMETER_ORDER{5, false};
+
+static ParameterOrder get_parameter_order(const std::string & nodeName)
 {
-  std::vector<std::string> sn;
-  for (size_t cam_idx = 0; cam_idx < cameraList_.GetSize(); cam_idx++) {
-    const auto cam = cameraList_.GetByIndex(cam_idx);
-    sn.push_back(get_serial(cam));
+  static const std::unordered_map<std::string, ParameterOrder> order{
+    {"PixelFormat", {0, true}},
+    {"AdcBitDepth", {0, true}},
+    {"BinningHorizontal", {1, true}},
+    {"BinningVertical", {1, true}},
+    {"DecimationHorizontal", {1, true}},
+    {"DecimationVertical", {1, true}},
+    {"Width", {2, true}},
+    {"Height", {2, true}},
+    {"OffsetX", {3, false}},
+    {"OffsetY", {3, false}},
+    {"ExposureMode", {4, false}},
+    {"ExposureAuto", {4, false}},
+    {"GainAuto", {4, false}},
+    {"BalanceWhiteAuto", {4, false}},
+    {"AcquisitionFrameRateAuto", {4, false}},
+    {"AcquisitionFrameRateEnable", {4, false}}};
+  // paths are ordered by their last component
+  const auto pos = nodeName.rfind('/');
+  auto it = order.find(
+    pos == std::string::npos ? nodeName : nodeName.substr(pos + 1));
+  return (it == order.end() ? DEFAULT_PARAMETER_ORDER : it->second);
+}
+
+Driver::ParameterResult DriverImpl::writeParameter(const Driver::Parameter & p)
+{
+  Driver::ParameterResult r;
+  r.value.name = p.name;
+  r.value.type = p.type;
+  switch (p.type) {
+    case Driver::ENUM:
+      r.message = camera_->setEnum(p.name, p.enumValue, &r.value.enumValue);
+      break;
+    case Driver::DOUBLE:
+      r.message =
+        camera_->setDouble(p.name, p.doubleValue, &r.value.doubleValue);
+      break;
+    case Driver::INT:
+      r.message = camera_->setInt(p.name, p.intValue, &r.value.intValue);
+      break;
+    case Driver::BOOL:
+      r.message = camera_->setBool(p.name, p.boolValue, &r.value.boolValue);
+      break;
   }
-  return sn;
+  r.ok = (r.message == "OK");
+  return (r);
 }
 
-std::string DriverImpl::setEnum(
-  const std::string & nodeName, const std::string & val, std::string * retVal)
+// must be called with the config cache mutex held
+bool DriverImpl::findCachedParameter(
+  const Driver::Parameter & p, Driver::ParameterResult * r)
 {
-  *retVal = "UNKNOWN";
-  GenApi::CNodePtr np = genicam_utils::find_node(nodeName, camera_, debug_);
-  std::string msg;
-  if (!common_checks(np, nodeName, &msg)) {
-    return (msg);
-  }
-  GenApi::CEnumerationPtr p = static_cast<GenApi::CEnumerationPtr>(np);
-  if (!is_writable(p)) {
-    return ("node " + nodeName + " not enum???");
-  }
-  // find integer corresponding to the enum string
-  GenApi::CEnumEntryPtr setVal = p->GetEntryByName(val.c_str());
-  if (!is_readable(setVal)) {
-    // bad enum value, try to read current value nevertheless
-    if (is_readable(p)) {
-      auto ce = p->GetCurrentEntry();
-      if (ce) {
-        *retVal = ce->GetSymbolic().c_str();
-      }
+  if (
+    !configCache_ || !configCache_->isPersistent() ||
+    !configCache_->find(p, &r->value)) {
+    return (false);
+  }
+  if (!configCacheTrusted_) {
+    // a read is much cheaper than a write and its read back
+    Driver::Parameter v(r->value);
+    int64_t i(0);
+    bool ok(false);
+    switch (v.type) {
+      case Driver::ENUM:
+        ok = camera_->getEnum(v.name, &v.enumValue);
+        break;
+      case Driver::DOUBLE:
+        ok = camera_->getDouble(v.name, &v.doubleValue);
+        break;
+      case Driver::INT:
+        ok = camera_->getInt(v.name, &i);
+        v.intValue = static_cast<int>(i);
+        break;
+      case Driver::BOOL:
+        ok = camera_->getBool(v.name, &v.boolValue);
+        break;
     }
-    if (debug_) {
-      std::cout << "node " << nodeName << " invalid enum: " << val << std::endl;
-      std::cout << "allowed enum values: " << std::endl;
-      GenApi::StringList_t validValues;
-      p->GetSymbolics(validValues);
-      for (const auto & ve : validValues) {
-        std::cout << "  " << ve << std::endl;
-      }
+    if (
+      !ok || v.enumValue != r->value.enumValue ||
+      v.doubleValue != r->value.doubleValue ||
+      v.intValue != r->value.intValue || v.boolValue != r->value.boolValue) {
+      return (false);
     }
-    return ("node " + nodeName + " invalid enum: " + val);
-  }
-  // set the new enum value
-  p->SetIntValue(setVal->GetValue());
-  // read it back
-  if (is_readable(p)) {
-    auto ce = p->GetCurrentEntry();
-    if (ce) {
-      *retVal = ce->GetSymbolic().c_str();
-    } else {
-      return ("node " + nodeName + " current entry not readable!");
+  }
+  r->ok = true;
+  r->message = "OK";
+  return (true);
+}
+
+Driver::ParameterResult DriverImpl::applyParameter(const Driver::Parameter & p)
+{
+  std::unique_lock<std::mutex> lock(configCacheMutex_);
+  Driver::ParameterResult r;
+  if (findCachedParameter(p, &r)) {
+    if (debug_) {
+      std::cout << "node " << p.name << " unchanged, not written" << std::endl;
     }
-  } else {
-    return ("node " + nodeName + " is not readable!");
+    return (r);
   }
-  return ("OK");
+  if (configCache_) {
+    configCache_->erase(p.name);  // in case the write throws
+  }
+  r = writeParameter(p);
+  if (configCache_ && r.ok) {
+    configCache_->update(p, r.value);
+  }
+  if (get_parameter_order(p.name).lockedWhileStreaming) {
+    // may have changed the values of other nodes
+    configCacheTrusted_ = false;
+  }
+  return (r);
 }
 
-template <class T>
-T set_invalid()
+Driver::ParameterResult DriverImpl::setParameter(const Driver::Parameter & p)
 {
-  return (std::nan(""));
+  Driver::ParameterResult r;
+  r.value.name = p.name;
+  r.value.type = p.type;
+  try {
+    r = applyParameter(p);
+  } catch (const std::exception & e) {
+    r.message = e.what();
+    r.ok = false;
+  }
+  return (r);
 }
 
-template <>
-int set_invalid()
+void DriverImpl::forgetCachedParameter(const std::string & nodeName)
 {
-  return (-1);
+  std::unique_lock<std::mutex> lock(configCacheMutex_);
+  if (configCache_) {
+    configCache_->erase(nodeName);
+  }
 }
 
-template <class T1, class T2>
-static std::string set_parameter(
-  const std::string & nodeName, T2 val, T2 * retVal,
-  const Spinnaker::CameraPtr & cam, bool debug)
+void DriverImpl::openConfigCache()
 {
-  *retVal = set_invalid<T2>();
-  GenApi::CNodePtr np = genicam_utils::find_node(nodeName, cam, debug);
-  std::string msg;
-  if (!common_checks(np, nodeName, &msg)) {
-    return (msg);
+  std::unique_lock<std::mutex> lock(configCacheMutex_);
+  configCacheTrusted_ = false;
+  if (configCacheConfig_.directory.empty()) {
+    // remembers the parameters for a reconnect, but skips nothing
+    if (!configCache_) {
+      configCache_.reset(new ConfigCache());
+    }
+    return;
+  }
+  configCache_.reset();
+  std::string serial, firmware;
+  if (
+    !camera_->getString("DeviceSerialNumber", &serial) ||
+    !camera_->getString("DeviceFirmwareVersion", &firmware)) {
+    std::cerr << "WARNING: cannot identify camera, no config cache!"
+              << std::endl;
+    return;
   }
-  T1 p = static_cast<T1>(np);
-  p->SetValue(val);
-  if (!is_readable(np)) {
-    return ("node " + nodeName + " current entry not readable!");
+  configCache_.reset(
+    new ConfigCache(configCacheConfig_.directory, serial, firmware));
+  if (!configCache_->load()) {
+    return;  // first start of this camera
+  }
+  // Loading the user set puts the camera in the state the cache
+  // describes, whether it was power cycled or changed since.
+  const std::string & userSet = configCache_->getUserSet();
+  std::string retVal;
+  if (
+    configCacheConfig_.useUserSet && !userSet.empty() &&
+    camera_->setEnum("UserSetSelector", userSet, &retVal) == "OK" &&
+    camera_->execute("UserSetLoad")) {
+    configCacheTrusted_ = true;
+  }
+  if (debug_) {
+    std::cout << "config cache has " << configCache_->size()
+              << " parameters, " << (configCacheTrusted_ ? "" : "not ")
+              << "loaded from user set" << std::endl;
   }
-  *retVal = p->GetValue();
-  return ("OK");
 }
 
-std::string DriverImpl::setDouble(
-  const std::string & nn, double val, double * retVal)
+bool DriverImpl::saveConfigCache()
 {
-  *retVal = std::nan("");
-  return (
-    set_parameter<GenApi::CFloatPtr, double>(nn, val, retVal, camera_, debug_));
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  return (persistConfigCache());
 }
 
-std::string DriverImpl::setBool(const std::string & nn, bool val, bool * retVal)
+// must be called with the camera mutex held
+bool DriverImpl::persistConfigCache()
 {
-  *retVal = !val;
-  return (
-    set_parameter<GenApi::CBooleanPtr, bool>(nn, val, retVal, camera_, debug_));
+  std::unique_lock<std::mutex> lock(configCacheMutex_);
+  if (
+    !configCache_ || !configCache_->isPersistent() ||
+    !configCache_->isModified()) {
+    return (true);
+  }
+  if (!configCacheConfig_.useUserSet || cameraRunning_) {
+    // the user set would not match the cache any more
+    configCache_->setUserSet("");
+    return (configCache_->save());
+  }
+  // never leave a cache file that claims a stale user set
+  configCache_->setUserSet("");
+  if (!configCache_->save()) {
+    return (false);
+  }
+  std::string retVal;
+  if (
+    camera_->setEnum("UserSetSelector", "UserSet1", &retVal) != "OK" ||
+    !camera_->execute("UserSetSave") ||
+    camera_->setEnum("UserSetDefault", "UserSet1", &retVal) != "OK") {
+    std::cerr << "WARNING: cannot save settings to user set!" << std::endl;
+    return (false);
+  }
+  configCache_->setUserSet("UserSet1");
+  return (configCache_->save());
 }
 
-std::string DriverImpl::setInt(const std::string & nn, int val, int * retVal)
+std::vector<Driver::ParameterResult> DriverImpl::setParameters(
+  const std::vector<Driver::Parameter> & params)
+{
+  std::vector<Driver::ParameterResult> results(params.size());
+  // the running state must not change between the check and the restart
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    for (auto & r : results) {
+      r.message = "camera not initialized!";
+    }
+    return (results);
+  }
+  // stable sort: selectors stay in front of the nodes they select
+  std::vector<size_t> order(params.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return (
+      get_parameter_order(params[a].name).priority <
+      get_parameter_order(params[b].name).priority);
+  });
+  bool restart = false;
+  if (cameraRunning_) {
+    for (const auto & p : params) {
+      if (
+        get_parameter_order(p.name).lockedWhileStreaming &&
+        camera_->isLocked(p.name)) {
+        restart = true;
+        break;
+      }
+    }
+  }
+  if (restart) {
+    stopStreaming();
+  }
+  for (const size_t i : order) {
+    results[i] = setParameter(params[i]);
+  }
+  if (restart && !startStreaming(callback_, deliveryConfig_)) {
+    std::cerr << "driver: failed to restart camera after "
+              << "setting parameters!" << std::endl;
+  }
+  return (results);
+}
+
+bool DriverImpl::getRoi(Driver::Roi * roi)
 {
-  *retVal = -1;
-  return (
-    set_parameter<GenApi::CIntegerPtr, int>(nn, val, retVal, camera_, debug_));
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  return (readRoi(roi));
 }
 
-double DriverImpl::getReceiveFrameRate() const
+// must be called with the camera mutex held
+bool DriverImpl::readRoi(Driver::Roi * roi)
 {
-  return (avgTimeInterval_ > 0 ? (1.0 / avgTimeInterval_) : 0);
+  int64_t x(0), y(0), w(0), h(0);
+  if (
+    !camera_ || !camera_->getInt("OffsetX", &x) ||
+    !camera_->getInt("OffsetY", &y) || !camera_->getInt("Width", &w) ||
+    !camera_->getInt("Height", &h)) {
+    return (false);
+  }
+  roi->offsetX = static_cast<size_t>(x);
+  roi->offsetY = static_cast<size_t>(y);
+  roi->width = static_cast<size_t>(w);
+  roi->height = static_cast<size_t>(h);
+  return (true);
 }
 
-static int int_ceil(size_t x, int y)
+static size_t align_down(size_t v, int64_t inc)
 {
-  // compute the integer ceil(x / y)
-  return (static_cast<int>((x + static_cast<size_t>(y) - 1) / y));
+  return (v - v % static_cast<size_t>(inc));
 }
 
-static int16_t compute_brightness(
-  pixel_format::PixelFormat pf, const uint8_t * data, size_t w, size_t h,
-  size_t stride, int skip)
+std::string DriverImpl::checkRoi(
+  const Driver::Roi & roi, Driver::Roi * checked)
 {
-  if (pf != pixel_format::BayerRG8) {
-    return (0);
+  Driver::Roi cur;
+  int64_t minW, maxW, incW, minH, maxH, incH, minX, maxX, incX, minY, maxY,
+    incY;
+  if (
+    !readRoi(&cur) || !camera_->getIntLimits("Width", &minW, &maxW, &incW) ||
+    !camera_->getIntLimits("Height", &minH, &maxH, &incH) ||
+    !camera_->getIntLimits("OffsetX", &minX, &maxX, &incX) ||
+    !camera_->getIntLimits("OffsetY", &minY, &maxY, &incY)) {
+    return ("cannot read region of interest!");
+  }
+  // the maximum size shrinks as the offset grows
+  const size_t sensorWidth = static_cast<size_t>(maxW) + cur.offsetX;
+  const size_t sensorHeight = static_cast<size_t>(maxH) + cur.offsetY;
+  checked->offsetX = align_down(roi.offsetX, incX);
+  checked->offsetY = align_down(roi.offsetY, incY);
+  checked->width = align_down(roi.width, incW);
+  checked->height = align_down(roi.height, incH);
+  if (
+    checked->width < static_cast<size_t>(minW) ||
+    checked->height < static_cast<size_t>(minH)) {
+    return ("region of interest too small!");
+  }
+  if (
+    checked->offsetX + checked->width > sensorWidth ||
+    checked->offsetY + checked->height > sensorHeight) {
+    return ("region of interest exceeds sensor!");
+  }
+  return ("OK");
+}
+
+std::string DriverImpl::writeRoi(
+  const Driver::Roi & r, const Driver::Roi & cur)
+{
+  // Every step keeps the region on the sensor: offsets move towards
+  // the origin first, then the size changes, then the offsets move out.
+  const std::vector<std::pair<std::string, size_t>> steps{
+    {"OffsetX", std::min(r.offsetX, cur.offsetX)},
+    {"OffsetY", std::min(r.offsetY, cur.offsetY)},
+    {"Width", r.width},
+    {"Height", r.height},
+    {"OffsetX", r.offsetX},
+    {"OffsetY", r.offsetY}};
+  Driver::Roi now = cur;
+  for (const auto & s : steps) {
+    forgetCachedParameter(s.first);
   }
-  const uint64_t cnt = int_ceil(w, skip) * int_ceil(h, skip);
-  uint64_t tot = 0;
-  const uint8_t * p = data;
-  for (size_t row = 0; row < h; row += skip) {
-    for (size_t col = 0; col < w; col += skip) {
-      tot += p[col];
+  for (const auto & s : steps) {
+    size_t * v = s.first == "OffsetX"
+                   ? &now.offsetX
+                   : (s.first == "OffsetY"
+                        ? &now.offsetY
+                        : (s.first == "Width" ? &now.width : &now.height));
+    if (*v == s.second) {
+      continue;
     }
-    p += stride * skip;
+    int retVal;
+    const std::string msg =
+      camera_->setInt(s.first, static_cast<int>(s.second), &retVal);
+    if (msg != "OK") {
+      return (msg);
+    }
+    *v = s.second;
   }
-  return (tot / cnt);
+  std::unique_lock<std::mutex> lock(configCacheMutex_);
+  if (configCache_) {
+    for (const auto & s : steps) {
+      const Driver::Parameter p(s.first, static_cast<int>(s.second));
+      configCache_->update(p, p);
+    }
+  }
+  return ("OK");
 }
 
-void DriverImpl::OnImageEvent(Spinnaker::ImagePtr imgPtr)
+std::string DriverImpl::setRoi(const Driver::Roi & roi, Driver::Roi * actual)
 {
-  // update frame rate
-  auto now = chrono::high_resolution_clock::now();
-  uint64_t t =
-    chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
-  if (avgTimeInterval_ == 0) {
-    if (lastTime_ != 0) {
-      avgTimeInterval_ = (t - lastTime_) * 1e-9;
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    return ("camera not initialized!");
+  }
+  Driver::Roi cur, r;
+  std::string msg = checkRoi(roi, &r);
+  if (msg == "OK" && readRoi(&cur)) {
+    const bool resize = r.width != cur.width || r.height != cur.height;
+    const bool restart =
+      cameraRunning_ && (resize || (r.offsetX != cur.offsetX &&
+                                    camera_->isLocked("OffsetX")) ||
+                         (r.offsetY != cur.offsetY &&
+                          camera_->isLocked("OffsetY")));
+    if (restart) {
+      pauseStream();
+    }
+    msg = writeRoi(r, cur);
+    if (restart) {
+      resumeStream();
     }
-  } else {
-    const double dt = (t - lastTime_) * 1e-9;
-    const double alpha = 0.01;
-    avgTimeInterval_ = avgTimeInterval_ * (1.0 - alpha) + dt * alpha;
   }
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    lastTime_ = t;
+  if (actual) {
+    readRoi(actual);
+  }
+  return (msg);
+}
+
+void DriverImpl::pauseStream()
+{
+  watchdog_.stop();
+  streamPaused_ = true;
+  // queued images hold stream buffers, let the workers deliver them
+  const auto q = std::atomic_load(&deliveryQueue_);
+  if (q && !q->drain(MAX_DRAIN_TIME)) {
+    std::cerr << "WARNING: delivery queue not drained!" << std::endl;
+  }
+  camera_->stopAcquisition();
+}
+
+void DriverImpl::resumeStream()
+{
+  // the frame size may have changed
+  setStreamBuffers();
+  numStreamBuffers_ = camera_->getStreamBufferCount();
+  // the frames dropped while paused are not lost
+  statistics_.resyncFrameId();
+  streamPaused_ = false;
+  camera_->startAcquisition(this);
+  startWatchdog();
+}
+
+double DriverImpl::getReceiveFrameRate() const
+{
+  Driver::Statistics s;
+  statistics_.getSnapshot(&s);
+  return (s.receiveFrameRate);
+}
+
+std::shared_ptr<void> DriverImpl::makeBufferHolder(
+  const CameraFrame & frame, const void ** data)
+{
+  if ((*numHeldBuffers_)++ < numBuffersToHold_) {
+    // hold on to the camera buffer, no copy needed
+    *data = frame.data;
+    return (camera_->holdFrame(
+      frame, numHeldBuffers_, PoolAllocator<Image>(imagePool_)));
+  }
+  (*numHeldBuffers_)--;
+  // The consumers hold too many buffers already. Copy the data
+  // such that the camera does not run out of stream buffers.
+  std::shared_ptr<uint8_t> buf = copyPool_->get(frame.imageSize);
+  memcpy(buf.get(), frame.data, frame.imageSize);
+  *data = buf.get();
+  return (buf);
+}
+
+void DriverImpl::onFrame(const CameraFrame & f)
+{
+  if (streamPaused_.load(std::memory_order_relaxed)) {
+    return;
   }
+  const uint64_t t = get_time();
+  const uint64_t imageTime =
+    static_cast<uint64_t>(std::max(f.imageTime, int64_t(0)));
+  statistics_.addFrame(t, imageTime, f.frameId, f.incomplete);
+  watchdog_.frameArrived(t);
 
-  if (imgPtr->IsIncomplete()) {
+  if (f.incomplete) {
     // Retrieve and print the image status description
-    std::cout << "Image incomplete: "
-              << Spinnaker::Image::GetImageStatusDescription(
-                   imgPtr->GetImageStatus())
+    std::cout << "Image incomplete: " << camera_->getStatusDescription(f.status)
               << std::endl;
   } else {
-    const Spinnaker::ChunkData & chunk = imgPtr->GetChunkData();
-    const float expTime = chunk.GetExposureTime();
-    const float gain = chunk.GetGain();
-    const int64_t stamp = chunk.GetTimestamp();
-    const uint32_t maxExpTime = static_cast<uint32_t>(
-      is_readable(exposureTimeNode_) ? exposureTimeNode_->GetMax() : 0);
-
-#if 0
-    std::cout << "got image: " << imgPtr->GetWidth() << "x"
-              << imgPtr->GetHeight() << " stride: " << imgPtr->GetStride()
-              << " ts: " << stamp << " exp time: " << expTime
-              << " gain: " << gain << " bpp: " << imgPtr->GetBitsPerPixel()
-              << " chan: " << imgPtr->GetNumChannels()
-              << " tl payload type: " << imgPtr->GetTLPayloadType()
-              << " tl pix fmt: " << imgPtr->GetTLPixelFormat()
-              << " payload type: " << imgPtr->GetPayloadType()
-              << " pixfmt enum: " << imgPtr->GetPixelFormat()
-              << " fmt: " << imgPtr->GetPixelFormatName()
-              << " int type: " << imgPtr->GetPixelFormatIntType()
-              << " frame id: " << imgPtr->GetFrameID()
-              << " img id: " << imgPtr->GetID() << std::endl;
-#endif
     // Note: GetPixelFormat() did not work for the grasshopper, so ignoring
     // pixel format in image, using the one from the configuration
     const int16_t brightness =
-      computeBrightness_
-        ? compute_brightness(
-            pixelFormat_, static_cast<const uint8_t *>(imgPtr->GetData()),
-            imgPtr->GetWidth(), imgPtr->GetHeight(), imgPtr->GetStride(),
-            brightnessSkipPixels_)
+      (computeBrightness_ || exposureController_)
+        ? brightness::compute_brightness(
+            pixelFormat_, static_cast<const uint8_t *>(f.data), f.width,
+            f.height, f.stride, brightnessSkipPixels_)
         : -1;
-    ImagePtr img(new Image(
-      t, brightness, expTime, maxExpTime, gain, stamp, imgPtr->GetImageSize(),
-      imgPtr->GetImageStatus(), imgPtr->GetData(), imgPtr->GetWidth(),
-      imgPtr->GetHeight(), imgPtr->GetStride(), imgPtr->GetBitsPerPixel(),
-      imgPtr->GetNumChannels(), imgPtr->GetFrameID(), pixelFormat_));
-    callback_(img);
+    if (exposureController_) {
+      ExposureController::Sample sample;
+      sample.brightness = brightness;
+      sample.exposureTime = f.exposureTime;
+      sample.gain = f.gain;
+      sample.maxExposureTime = f.maxExposureTime;
+      exposureController_->addSample(sample);
+    }
+    const void * data = f.data;
+    std::shared_ptr<void> holder;
+    if (holdBuffers_) {
+      holder = makeBufferHolder(f, &data);
+    }
+    // object and control block both come from the pool
+    ImagePtr img = std::allocate_shared<Image>(
+      PoolAllocator<Image>(imagePool_), t, brightness, f.exposureTime,
+      f.maxExposureTime, f.gain, f.imageTime, f.imageSize, f.status, data,
+      f.width, f.height, f.stride, f.bitsPerPixel, f.numChannels, f.frameId,
+      pixelFormat_, holder);
+    img->correctedTime_ = clockEstimator_.update(t, imageTime);
+    img->offsetX_ = f.offsetX;
+    img->offsetY_ = f.offsetY;
+    if (deliveryQueue_) {
+      deliveryQueue_->push(img);
+    } else {
+      // must not unwind into the acquisition thread
+      try {
+        callback_(img);
+      } catch (const std::exception & e) {
+        std::cerr << "image callback failed: " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "image callback failed!" << std::endl;
+      }
+      const uint64_t dt = get_time() - t;
+      statistics_.addCallbackTime(dt);
+      statistics_.addDeliveryLatency(dt);
+    }
   }
-}  // namespace flir_spinnaker_common
+}
 
-bool DriverImpl::initCamera(const std::string & serialNumber)
+bool DriverImpl::initSyntheticCamera(
+  const Driver::SyntheticCameraConfig & config)
 {
+  return (initCamera(config.serialNumber, [config]() {
+    return (std::make_shared<SyntheticCamera>(config));
+  }));
+}
+
+bool DriverImpl::initCamera(
+  const std::string & serial, const CameraFactory & factory)
+{
+  std::unique_lock<std::mutex> lock(cameraMutex_);
   if (camera_) {
-    return false;
+    return (false);
   }
-  for (size_t cam_idx = 0; cam_idx < cameraList_.GetSize(); cam_idx++) {
-    auto cam = cameraList_.GetByIndex(cam_idx);
-    const std::string sn = get_serial(cam);
-    if (sn == serialNumber) {
-      camera_ = cam;
-      camera_->Init();
-      break;
-    }
+  std::shared_ptr<Camera> cam = factory();
+  if (!cam) {
+    return (false);
   }
-  return (camera_ != 0);
+  initCamera(cam);
+  serialNumber_ = serial;
+  cameraFactory_ = factory;
+  cameraLost_ = false;
+  return (true);
+}
+
+void DriverImpl::initCamera(const std::shared_ptr<Camera> & cam)
+{
+  cam->setDebug(debug_);
+  cam->init();
+  std::atomic_store(&camera_, cam);
+  openConfigCache();
 }
 
 bool DriverImpl::deInitCamera()
 {
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  // a lost camera is not initialized again
+  cameraLost_ = false;
+  cameraFactory_ = CameraFactory();
   if (!camera_) {
+    std::unique_lock<std::mutex> cacheLock(configCacheMutex_);
+    configCache_.reset();
     return (false);
   }
-  camera_->DeInit();
+  persistConfigCache();
+  {
+    std::unique_lock<std::mutex> cacheLock(configCacheMutex_);
+    configCache_.reset();
+  }
+  camera_->deInit();
+  std::atomic_store(&camera_, std::shared_ptr<Camera>());
   return (true);
 }
 
-bool DriverImpl::startCamera(const Driver::Callback & cb)
+bool DriverImpl::startCamera(
+  const Driver::Callback & cb, const Driver::DeliveryConfig & dc)
 {
+  std::unique_lock<std::mutex> lock(cameraMutex_);
   if (!camera_ || cameraRunning_) {
     return false;
   }
+  return (startStreaming(cb, dc));
+}
+
+// must be called with the camera mutex held
+bool DriverImpl::startStreaming(
+  const Driver::Callback & cb, const Driver::DeliveryConfig & dc)
+{
   // switch on continuous acquisition
-  // and get pixel format
-  GenApi::INodeMap & nodeMap = camera_->GetNodeMap();
-  if (set_acquisition_mode_continuous(nodeMap)) {
-    camera_->RegisterEventHandler(*this);
-    camera_->BeginAcquisition();
-    thread_ = std::make_shared<std::thread>(&DriverImpl::monitorStatus, this);
-    cameraRunning_ = true;
-
-    GenApi::CEnumerationPtr ptrPixelFormat = nodeMap.GetNode("PixelFormat");
-    if (GenApi::IsAvailable(ptrPixelFormat)) {
-      setPixelFormat(ptrPixelFormat->GetCurrentEntry()->GetSymbolic().c_str());
-    } else {
-      setPixelFormat("BayerRG8");
-      std::cerr << "WARNING: driver could not read pixel format!" << std::endl;
-    }
-    exposureTimeNode_ = nodeMap.GetNode("ExposureTime");
-  } else {
+  if (!applyParameter(Driver::Parameter("AcquisitionMode", "Continuous")).ok) {
     std::cerr << "failed to switch on continuous acquisition!" << std::endl;
     return (false);
   }
+  // the pixel format is needed as soon as the first frame arrives
+  std::string pixFmt;
+  if (camera_->getEnum("PixelFormat", &pixFmt)) {
+    setPixelFormat(pixFmt);
+  } else {
+    setPixelFormat("BayerRG8");
+    std::cerr << "WARNING: driver could not read pixel format!" << std::endl;
+  }
+  const bool async = (dc.mode == Driver::ASYNCHRONOUS);
+  // queued images must stay valid after onFrame() returns
+  holdBuffers_ = zeroCopy_ || async;
+  numBuffersToHold_ =
+    holdBuffers_
+      ? maxHeldBuffers_ +
+          (async ? static_cast<int>(dc.queueSize) + dc.numThreads : 0)
+      : 0;
+  setStreamBuffers();
+  numStreamBuffers_ = camera_->getStreamBufferCount();
+  // Images are released by the consumers, so there can be as many
+  // in flight as there are stream buffers plus the ones held.
+  // Two blocks per image: one for the image, one for the buffer holder.
+  const size_t numImages =
+    static_cast<size_t>(numStreamBuffers_ + numBuffersToHold_);
+  std::atomic_store(
+    &imagePool_, std::make_shared<MemoryPool>(
+                   sizeof(Image) + IMAGE_POOL_BLOCK_OVERHEAD, 2 * numImages));
+  // for the copies made when the consumers hold too many buffers
+  std::atomic_store(
+    &copyPool_, std::make_shared<BufferPool>(
+                  static_cast<size_t>(std::max(numBuffersToHold_, 1))));
   callback_ = cb;
+  deliveryConfig_ = dc;
+  statistics_.reset();
+  clockEstimator_.reset();
+  std::atomic_store(
+    &deliveryQueue_,
+    async ? std::make_shared<DeliveryQueue>(
+              dc,
+              [this, cb](const ImageConstPtr & img) {
+                const uint64_t t0 = get_time();
+                cb(img);
+                const uint64_t t1 = get_time();
+                statistics_.addCallbackTime(t1 - t0);
+                statistics_.addDeliveryLatency(t1 - img->time_);
+              })
+          : std::shared_ptr<DeliveryQueue>());
+  startExposureControl();
+  // the user set can only be saved while the camera is not streaming
+  persistConfigCache();
+  camera_->setAcquisitionThreadConfig(acquisitionThreadConfig_);
+  camera_->startAcquisition(this);
+  startWatchdog();
+  cameraRunning_ = true;
   return (true);
 }
 
 bool DriverImpl::stopCamera()
 {
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  restartOnReconnect_ = false;
   if (camera_ && cameraRunning_) {
-    if (thread_) {
-      keepRunning_ = false;
-      thread_->join();
-      thread_ = 0;
-    }
-    camera_->EndAcquisition();  // before unregistering the event handler!
-    camera_->UnregisterEventHandler(*this);
-
-    cameraRunning_ = false;
+    stopStreaming();
     return true;
   }
   return (false);
 }
 
+// must be called with the camera mutex held
+void DriverImpl::stopStreaming()
+{
+  // restarts skip while the lock is held, so no deadlock here
+  watchdog_.stop();
+  if (exposureController_) {
+    exposureController_->stop();  // no more camera writes
+  }
+  if (deliveryQueue_) {
+    // returns all queued buffers while the stream is still up
+    deliveryQueue_->stop();
+  }
+  // the state must be consistent even if the device is gone
+  std::exception_ptr error;
+  try {
+    camera_->stopAcquisition();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  std::atomic_store(&deliveryQueue_, std::shared_ptr<DeliveryQueue>());
+  exposureController_.reset();
+  cameraRunning_ = false;
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void DriverImpl::startExposureControl()
+{
+  exposureController_.reset();
+  if (!exposureControlConfig_.enabled) {
+    return;
+  }
+  applyParameter(Driver::Parameter("ExposureAuto", "Off"));
+  applyParameter(Driver::Parameter("GainAuto", "Off"));
+  double et, gain = 0;
+  if (
+    !camera_->getDouble("ExposureTime", &et) ||
+    camera_->isLocked("ExposureTime")) {
+    std::cerr << "driver: ExposureTime not writable, "
+              << "exposure control disabled!" << std::endl;
+    return;
+  }
+  camera_->getDouble("Gain", &gain);
+  // the controller writes them behind the cache's back
+  forgetCachedParameter("ExposureTime");
+  forgetCachedParameter("Gain");
+  exposureController_ =
+    std::make_shared<ExposureController>(exposureControlConfig_, et, gain);
+  // runs on the controller thread, the camera caches the node handles
+  std::shared_ptr<Camera> cam = camera_;
+  exposureController_->start([cam](double e, double g) {
+    try {
+      cam->setExposure(e, g);
+    } catch (const std::exception & ex) {
+      std::cerr << "driver: exposure control failed: " << ex.what()
+                << std::endl;
+    }
+  });
+}
+
+size_t DriverImpl::getFrameSize()
+{
+  int64_t size(0), w(0), h(0);
+  if (camera_->getInt("PayloadSize", &size) && size > 0) {
+    return (static_cast<size_t>(size));
+  }
+  if (camera_->getInt("Width", &w) && camera_->getInt("Height", &h)) {
+    return (static_cast<size_t>(
+      w * h * pixel_format::get_traits(pixelFormat_).bitsPerPixel / 8));
+  }
+  return (0);
+}
+
+void DriverImpl::setStreamBuffers()
+{
+  // Images handed out to the consumers hold on to stream buffers.
+  // Add that many to the ones needed for streaming so the camera
+  // does not starve.
+  const int64_t numHeld = numBuffersToHold_;
+  int64_t count = camera_->getDefaultStreamBufferCount() + numHeld;
+  std::string mode;
+  switch (streamingConfig_.profile) {
+    case Driver::LOW_LATENCY:
+      mode = "NewestOnly";
+      count = LOW_LATENCY_BUFFERS + numHeld;
+      break;
+    case Driver::HIGH_THROUGHPUT: {
+      mode = "OldestFirst";
+      const uint64_t interval = getExpectedFrameInterval();
+      if (interval != 0) {
+        const int64_t n = static_cast<int64_t>(
+          std::ceil(streamingConfig_.bufferTime * 1e9 / interval));
+        count = std::max(count, n + numHeld);
+      }
+      const size_t frameSize = getFrameSize();
+      if (frameSize != 0) {
+        const int64_t maxCount =
+          static_cast<int64_t>(streamingConfig_.maxBufferMemory / frameSize);
+        count =
+          std::max(std::min(count, maxCount), LOW_LATENCY_BUFFERS + numHeld);
+      }
+      break;
+    }
+    default:
+      if (!holdBuffers_) {
+        return;  // leave the SDK defaults alone
+      }
+      break;
+  }
+  if (!mode.empty() && !camera_->setStreamBufferHandling(mode)) {
+    std::cerr << "WARNING: cannot set stream buffer handling mode!"
+              << std::endl;
+  }
+  if (!camera_->setStreamBufferCount(count)) {
+    std::cerr << "WARNING: cannot set stream buffer count!" << std::endl;
+  }
+}
+
+void DriverImpl::getImagePoolStatistics(
+  uint64_t * hits, uint64_t * misses) const
+{
+  const auto pool = std::atomic_load(&imagePool_);
+  *hits = pool ? pool->getHits() : 0;
+  *misses = pool ? pool->getMisses() : 0;
+}
+
+Driver::Statistics DriverImpl::getStatistics() const
+{
+  Driver::Statistics s;
+  statistics_.getSnapshot(&s);
+  getImagePoolStatistics(&s.poolHits, &s.poolMisses);
+  getDeliveryQueueStatistics(&s.queueDepth, &s.numDropped);
+  watchdog_.getStatistics(&s);
+  s.numStreamBuffers = numStreamBuffers_;
+  s.clockDrift = clockEstimator_.getDrift();
+  return (s);
+}
+
+Driver::FrameDropStatistics DriverImpl::getFrameDropStatistics() const
+{
+  Driver::FrameDropStatistics s;
+  statistics_.getFrameDrops(&s);
+  size_t depth;
+  getDeliveryQueueStatistics(&depth, &s.numDroppedByConsumer);
+  // polled without the camera mutex, the camera may go away meanwhile
+  const auto cam = std::atomic_load(&camera_);
+  if (cam) {
+    cam->getStreamStatistics(&s);
+  }
+  return (s);
+}
+
+void DriverImpl::getDeliveryQueueStatistics(
+  size_t * depth, uint64_t * dropped) const
+{
+  const auto q = std::atomic_load(&deliveryQueue_);
+  *depth = q ? q->getDepth() : 0;
+  *dropped = q ? q->getNumDropped() : 0;
+}
+
 void DriverImpl::setPixelFormat(const std::string & pixFmt)
 {
   pixelFormat_ = pixel_format::from_nodemap_string(pixFmt);
@@ -431,31 +1038,190 @@ std::string DriverImpl::getPixelFormat() const
 
 std::string DriverImpl::getNodeMapAsString()
 {
-  std::stringstream ss;
-  genicam_utils::get_nodemap_as_string(ss, camera_);
-  return (ss.str());
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    return (std::string());
+  }
+  std::unique_lock<std::mutex> cacheLock(configCacheMutex_);
+  std::string nodeMap;
+  if (configCache_ && configCache_->loadNodeMap(&nodeMap)) {
+    return (nodeMap);
+  }
+  nodeMap = camera_->getNodeMapAsString();
+  if (configCache_ && !configCache_->saveNodeMap(nodeMap)) {
+    std::cerr << "WARNING: cannot write node map to cache!" << std::endl;
+  }
+  return (nodeMap);
+}
+
+uint64_t DriverImpl::getExpectedFrameInterval()
+{
+  // a triggered camera has no frame rate to go by
+  std::string triggerMode;
+  if (camera_->getEnum("TriggerMode", &triggerMode) && triggerMode != "Off") {
+    return (0);
+  }
+  double rate(0);
+  if (!camera_->getDouble("AcquisitionFrameRate", &rate) || rate <= 0) {
+    return (0);
+  }
+  return (static_cast<uint64_t>(1e9 / rate));
+}
+
+void DriverImpl::startWatchdog()
+{
+  watchdog_.start(
+    getExpectedFrameInterval(), acquisitionTimeout_,
+    [this]() { restartAcquisition(); });
+}
+
+void DriverImpl::setDeviceCallback(const Driver::DeviceCallback & cb)
+{
+  {
+    std::unique_lock<std::mutex> lock(deviceCallbackMutex_);
+    deviceCallback_ = cb;
+  }
+  if (cb) {
+    watchDevices();  // the events come from the Spinnaker System
+  }
+}
+
+void DriverImpl::notifyDeviceEvent(
+  const std::string & serial, Driver::DeviceEvent e)
+{
+  Driver::DeviceCallback cb;
+  {
+    std::unique_lock<std::mutex> lock(deviceCallbackMutex_);
+    cb = deviceCallback_;
+  }
+  if (cb) {
+    cb(serial, e);
+  }
+}
+
+// runs on the system wrapper's event thread
+void DriverImpl::onDeviceEvent(const std::string & serial, bool arrived)
+{
+  bool ours;
+  {
+    std::unique_lock<std::mutex> lock(cameraMutex_);
+    ours = (serial == serialNumber_) && (cameraLost_ || camera_);
+  }
+  if (!arrived) {
+    if (ours) {
+      onCameraLost();
+    }
+    notifyDeviceEvent(serial, Driver::DEVICE_REMOVED);
+    return;
+  }
+  notifyDeviceEvent(serial, Driver::DEVICE_ARRIVED);
+  if (ours && autoReconnect_) {
+    const auto t0 = chrono::steady_clock::now();
+    const bool ok = reconnectCamera();
+    std::cout << "camera " << serial
+              << (ok ? " reconnected in " : " failed to reconnect after ")
+              << chrono::duration<double>(chrono::steady_clock::now() - t0)
+                   .count()
+              << "s" << std::endl;
+    notifyDeviceEvent(
+      serial,
+      ok ? Driver::DEVICE_RECONNECTED : Driver::DEVICE_RECONNECT_FAILED);
+  }
+}
+
+void DriverImpl::onCameraLost()
+{
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!camera_) {
+    return;
+  }
+  std::cerr << "WARNING: camera " << serialNumber_ << " was removed!"
+            << std::endl;
+  cameraLost_ = true;
+  restartOnReconnect_ = cameraRunning_;
+  // the device is gone, so most of this fails, but the driver
+  // must end up in the same state as after deInitCamera()
+  try {
+    if (cameraRunning_) {
+      stopStreaming();
+    }
+  } catch (const std::exception & e) {
+    std::cerr << "stopping lost camera: " << e.what() << std::endl;
+  }
+  {
+    std::unique_lock<std::mutex> cacheLock(configCacheMutex_);
+    if (configCache_ && configCache_->isModified()) {
+      configCache_->setUserSet("");  // the camera's user set is stale
+      configCache_->save();
+    }
+    // keeps the parameters for the reconnect
+  }
+  try {
+    camera_->deInit();
+  } catch (const std::exception & e) {
+    std::cerr << "deinit of lost camera: " << e.what() << std::endl;
+  }
+  std::atomic_store(&camera_, std::shared_ptr<Camera>());
 }
 
-void DriverImpl::monitorStatus()
+bool DriverImpl::reconnectCamera()
 {
-  while (keepRunning_) {
-    std::this_thread::sleep_for(chrono::seconds(1));
-    uint64_t lastTime;
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      lastTime = lastTime_;
+  std::unique_lock<std::mutex> lock(cameraMutex_);
+  if (!cameraLost_ || camera_ || !cameraFactory_) {
+    return (false);
+  }
+  std::vector<Driver::Parameter> params;
+  {
+    std::unique_lock<std::mutex> cacheLock(configCacheMutex_);
+    if (configCache_) {
+      params = configCache_->getParameters();
     }
-    auto now = chrono::high_resolution_clock::now();
-    uint64_t t =
-      chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch())
-        .count();
-    if (t - lastTime > acquisitionTimeout_ && camera_) {
-      std::cout << "WARNING: acquisition timeout, restarting!" << std::endl;
-      // Mucking with the camera in this thread without proper
-      // locking does not feel good. Expect some rare crashes.
-      camera_->EndAcquisition();
-      camera_->BeginAcquisition();
+  }
+  try {
+    std::shared_ptr<Camera> cam = cameraFactory_();
+    if (!cam) {
+      return (false);
     }
+    // with a user set, this already restores the parameters
+    initCamera(cam);
+  } catch (const std::exception & e) {
+    std::cerr << "reinit of camera failed: " << e.what() << std::endl;
+    std::atomic_store(&camera_, std::shared_ptr<Camera>());
+    return (false);
+  }
+  cameraLost_ = false;
+  // in case the cache has no user set, or a different firmware
+  std::stable_sort(
+    params.begin(), params.end(),
+    [](const Driver::Parameter & a, const Driver::Parameter & b) {
+      return (
+        get_parameter_order(a.name).priority <
+        get_parameter_order(b.name).priority);
+    });
+  for (const auto & p : params) {
+    const Driver::ParameterResult r = setParameter(p);
+    if (!r.ok) {
+      std::cerr << "restoring " << p.name << " failed: " << r.message
+                << std::endl;
+    }
+  }
+  // stopCamera() after the removal clears the flag
+  return (!restartOnReconnect_ || startStreaming(callback_, deliveryConfig_));
+}
+
+void DriverImpl::restartAcquisition()
+{
+  // If the camera is being started or stopped right now, that
+  // restarts the stream anyway.
+  std::unique_lock<std::mutex> lock(cameraMutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !cameraRunning_) {
+    return;
+  }
+  std::cout << "WARNING: acquisition timeout, restarting!" << std::endl;
+  try {
+    camera_->restartAcquisition();
+  } catch (const std::exception & e) {
+    std::cerr << "restart failed: " << e.what() << std::endl;
   }
 }
 
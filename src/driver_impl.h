@@ -16,27 +16,42 @@
 #ifndef DRIVER_IMPL_H_
 #define DRIVER_IMPL_H_
 
-#include <SpinGenApi/SpinnakerGenApi.h>
-#include <Spinnaker.h>
 #include <flir_spinnaker_common/driver.h>
 #include <flir_spinnaker_common/image.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "buffer_pool.h"
+#include "camera.h"
+#include "clock_estimator.h"
+#include "config_cache.h"
+#include "delivery_queue.h"
+#include "exposure_controller.h"
+#include "frame_statistics.h"
+#include "memory_pool.h"
+#include "watchdog.h"
+
 namespace flir_spinnaker_common
 {
-class DriverImpl : public Spinnaker::ImageEventHandler
+class SystemWrapper;
+//
+// Driver logic on top of a Camera backend: per-frame processing,
+// delivery, statistics, exposure control and the watchdog.
+//
+class DriverImpl : public Camera::FrameHandler
 {
 public:
   DriverImpl();
   ~DriverImpl();
   // ------- inherited methods
-  // from ImageEventHandler
-  void OnImageEvent(Spinnaker::ImagePtr image) override;
+  // from Camera::FrameHandler
+  void onFrame(const CameraFrame & frame) override;
 
   // ------- own methods
   std::string getLibraryVersion() const;
@@ -45,9 +60,11 @@ public:
   std::string getPixelFormat() const;
 
   bool initCamera(const std::string & serialNumber);
+  bool initSyntheticCamera(const Driver::SyntheticCameraConfig & config);
   bool deInitCamera();
 
-  bool startCamera(const Driver::Callback & cb);
+  bool startCamera(
+    const Driver::Callback & cb, const Driver::DeliveryConfig & dc);
   bool stopCamera();
 
   double getReceiveFrameRate() const;
@@ -60,35 +77,133 @@ public:
     const std::string & nodeName, double val, double * retVal);
   std::string setInt(const std::string & nodeName, int val, int * retVal);
   std::string setBool(const std::string & nodeName, bool val, bool * retVal);
-  void setDebug(bool b) { debug_ = b; }
+  std::vector<Driver::ParameterResult> setParameters(
+    const std::vector<Driver::Parameter> & params);
+  std::string setRoi(const Driver::Roi & roi, Driver::Roi * actual);
+  bool getRoi(Driver::Roi * roi);
+  void setDebug(bool b);
   void setComputeBrightness(bool b) { computeBrightness_ = b; }
+  void setBrightnessSkip(int skip) { brightnessSkipPixels_ = skip; }
   void setAcquisitionTimeout(double t)
   {
     acquisitionTimeout_ = static_cast<uint64_t>(t * 1e9);
   }
+  void setExposureControl(const Driver::ExposureControlConfig & c)
+  {
+    exposureControlConfig_ = c;
+  }
+  void setZeroCopy(bool b) { zeroCopy_ = b; }
+  void setMaxHeldBuffers(int n) { maxHeldBuffers_ = n; }
+  void setStreamingConfig(const Driver::StreamingConfig & c)
+  {
+    streamingConfig_ = c;
+  }
+  void setAcquisitionThreadConfig(const Driver::AcquisitionThreadConfig & c)
+  {
+    acquisitionThreadConfig_ = c;
+  }
+  void setConfigCache(const Driver::ConfigCacheConfig & c)
+  {
+    configCacheConfig_ = c;
+  }
+  void setDeviceCallback(const Driver::DeviceCallback & cb);
+  void setAutoReconnect(bool b) { autoReconnect_ = b; }
+  bool saveConfigCache();
+  void getImagePoolStatistics(uint64_t * hits, uint64_t * misses) const;
+  void getDeliveryQueueStatistics(size_t * depth, uint64_t * dropped) const;
+  Driver::Statistics getStatistics() const;
+  Driver::FrameDropStatistics getFrameDropStatistics() const;
 
 private:
+  typedef std::function<std::shared_ptr<Camera>()> CameraFactory;
+  bool initCamera(const std::string & serial, const CameraFactory & factory);
+  // must be called with the camera mutex held
+  void initCamera(const std::shared_ptr<Camera> & cam);
+  bool persistConfigCache();
+  bool readRoi(Driver::Roi * roi);
+  bool startStreaming(
+    const Driver::Callback & cb, const Driver::DeliveryConfig & dc);
+  void stopStreaming();
+  // The Spinnaker System is created on the first use of a real camera,
+  // so the synthetic camera runs without it (or without the SDK).
+  std::shared_ptr<SystemWrapper> getSystem() const;
+  // hot plug
+  void watchDevices();
+  void unwatchDevices();
+  void onDeviceEvent(const std::string & serial, bool arrived);
+  void onCameraLost();
+  bool reconnectCamera();
+  void notifyDeviceEvent(const std::string & serial, Driver::DeviceEvent e);
   void setPixelFormat(const std::string & pixFmt);
-  bool setInINodeMap(double f, const std::string & field, double * fret);
-  void monitorStatus();
+  void restartAcquisition();
+  void startWatchdog();
+  std::string checkRoi(const Driver::Roi & roi, Driver::Roi * checked);
+  std::string writeRoi(const Driver::Roi & roi, const Driver::Roi & current);
+  // stream restart that keeps the driver side running
+  void pauseStream();
+  void resumeStream();
+  uint64_t getExpectedFrameInterval();
+  void setStreamBuffers();
+  size_t getFrameSize();
+  void startExposureControl();
+  Driver::ParameterResult setParameter(const Driver::Parameter & p);
+  // goes through the config cache, throws on SDK errors
+  Driver::ParameterResult applyParameter(const Driver::Parameter & p);
+  Driver::ParameterResult writeParameter(const Driver::Parameter & p);
+  bool findCachedParameter(
+    const Driver::Parameter & p, Driver::ParameterResult * r);
+  void openConfigCache();
+  void forgetCachedParameter(const std::string & nodeName);
+  std::shared_ptr<void> makeBufferHolder(
+    const CameraFrame & frame, const void ** data);
 
   // ----- variables --
-  Spinnaker::SystemPtr system_;
-  Spinnaker::CameraList cameraList_;
-  Spinnaker::CameraPtr camera_;
+  mutable std::mutex systemMutex_;  // for system_ and deviceCallbackId_
+  mutable std::shared_ptr<SystemWrapper> system_;
+  // Written with the camera mutex held and while not acquiring. Other
+  // threads that do not hold the mutex must take a std::atomic_load() copy.
+  std::shared_ptr<Camera> camera_;
   Driver::Callback callback_;
-  double avgTimeInterval_{0};
-  uint64_t lastTime_{0};
+  Driver::DeliveryConfig deliveryConfig_;
   bool cameraRunning_{false};
+  std::atomic<bool> streamPaused_{false};  // frames are dropped
   bool debug_{false};
   bool computeBrightness_{false};
   int brightnessSkipPixels_{32};
   pixel_format::PixelFormat pixelFormat_{pixel_format::INVALID};
-  Spinnaker::GenApi::CFloatPtr exposureTimeNode_;
-  bool keepRunning_{true};
-  std::shared_ptr<std::thread> thread_;
-  std::mutex mutex_;
   uint64_t acquisitionTimeout_{10000000000ULL};
+  bool zeroCopy_{false};
+  int maxHeldBuffers_{8};
+  std::shared_ptr<std::atomic<int>> numHeldBuffers_{
+    std::make_shared<std::atomic<int>>(0)};
+  std::shared_ptr<MemoryPool> imagePool_;
+  std::shared_ptr<BufferPool> copyPool_;
+  bool holdBuffers_{false};  // zero copy or asynchronous delivery
+  int numBuffersToHold_{0};
+  Driver::StreamingConfig streamingConfig_;
+  Driver::AcquisitionThreadConfig acquisitionThreadConfig_;
+  Driver::ConfigCacheConfig configCacheConfig_;
+  std::mutex configCacheMutex_;
+  std::unique_ptr<ConfigCache> configCache_;
+  // camera state is known to match the cache, no need to read back
+  bool configCacheTrusted_{false};
+  std::atomic<int64_t> numStreamBuffers_{0};
+  std::shared_ptr<DeliveryQueue> deliveryQueue_;
+  FrameStatistics statistics_;
+  ClockEstimator clockEstimator_;
+  Driver::ExposureControlConfig exposureControlConfig_;
+  std::shared_ptr<ExposureController> exposureController_;
+  std::mutex cameraMutex_;  // serializes init, start, stop and restart
+  // for initializing the camera again after it was removed
+  std::string serialNumber_;
+  CameraFactory cameraFactory_;
+  bool cameraLost_{false};
+  bool restartOnReconnect_{false};
+  std::atomic<bool> autoReconnect_{true};
+  int deviceCallbackId_{-1};
+  std::mutex deviceCallbackMutex_;
+  Driver::DeviceCallback deviceCallback_;
+  Watchdog watchdog_{statistics_};
 };
 }  // namespace flir_spinnaker_common
 
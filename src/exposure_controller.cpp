@@ -0,0 +1,179 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exposure_controller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace flir_spinnaker_common
+{
+// largest factor by which the exposure changes in one step
+static const double MAX_STEP = 8.0;
+// saturated images only tell that the exposure is too high, step down
+// by this factor
+static const double SATURATED_BRIGHTNESS = 250.0;
+static const double SATURATED_STEP = 0.25;
+// give up waiting for frames with the new settings after this many
+static const uint64_t MAX_SETTLE_FRAMES = 8;
+// relative difference at which two exposure settings are the same
+static const double SAME_EXPOSURE = 0.02;
+static const double SAME_GAIN = 0.1;  // dB
+
+static double db_to_linear(double db) { return (std::pow(10.0, db / 20.0)); }
+static double linear_to_db(double f) { return (20.0 * std::log10(f)); }
+
+ExposureController::ExposureController(
+  const Driver::ExposureControlConfig & config, double exposureTime,
+  double gain)
+: config_(config), exposureTime_(exposureTime), gain_(gain)
+{
+}
+
+ExposureController::~ExposureController() { stop(); }
+
+void ExposureController::start(const Setter & setter)
+{
+  setter_ = setter;
+  keepRunning_ = true;
+  thread_ = std::thread(&ExposureController::run, this);
+}
+
+void ExposureController::stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void ExposureController::addSample(const Sample & s)
+{
+  // Seqlock: the sequence number is odd while the fields are updated,
+  // so the reader can detect a torn sample and retry.
+  const uint64_t seq = slot_.sequence.load(std::memory_order_relaxed);
+  slot_.sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot_.brightness.store(s.brightness, std::memory_order_relaxed);
+  slot_.exposureTime.store(s.exposureTime, std::memory_order_relaxed);
+  slot_.gain.store(s.gain, std::memory_order_relaxed);
+  slot_.maxExposureTime.store(s.maxExposureTime, std::memory_order_relaxed);
+  slot_.sequence.store(seq + 2, std::memory_order_release);
+}
+
+uint64_t ExposureController::readSample(Sample * s) const
+{
+  while (true) {
+    const uint64_t seq = slot_.sequence.load(std::memory_order_acquire);
+    if (seq & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    s->brightness = slot_.brightness.load(std::memory_order_relaxed);
+    s->exposureTime = slot_.exposureTime.load(std::memory_order_relaxed);
+    s->gain = slot_.gain.load(std::memory_order_relaxed);
+    s->maxExposureTime = slot_.maxExposureTime.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot_.sequence.load(std::memory_order_relaxed) == seq) {
+      return (seq);
+    }
+  }
+}
+
+bool ExposureController::update(
+  const Sample & s, uint64_t numFrames, double * exposureTime, double * gain)
+{
+  if (s.brightness < 0) {
+    return (false);
+  }
+  // without chunk data, assume the last commanded settings
+  const double et = s.exposureTime > 0 ? s.exposureTime : exposureTime_;
+  const double g = s.exposureTime > 0 ? s.gain : gain_;
+  if (settling_) {
+    // frames exposed with the old settings carry no new information
+    const bool isOld = std::abs(et - exposureTime_) > SAME_EXPOSURE * et ||
+                       std::abs(g - gain_) > SAME_GAIN;
+    numSettleFrames_ += numFrames;
+    if (isOld && numSettleFrames_ < MAX_SETTLE_FRAMES) {
+      return (false);
+    }
+    settling_ = false;
+  }
+  const double b = std::max(static_cast<double>(s.brightness), 1.0);
+  if (std::abs(config_.targetBrightness - b) <= config_.tolerance) {
+    return (false);
+  }
+  // brightness is roughly proportional to exposure time times gain
+  double ratio = b >= SATURATED_BRIGHTNESS
+                   ? SATURATED_STEP
+                   : std::min(
+                       std::max(config_.targetBrightness / b, 1.0 / MAX_STEP),
+                       MAX_STEP);
+  ratio = std::pow(ratio, 1.0 - std::min(std::max(config_.damping, 0.0), 0.99));
+  const double total = et * db_to_linear(g) * ratio;
+  double maxEt = s.maxExposureTime > 0 ? s.maxExposureTime : total;
+  if (config_.maxExposureTime > 0) {
+    maxEt = std::min(maxEt, config_.maxExposureTime);
+  }
+  maxEt = std::max(maxEt, config_.minExposureTime);
+  const double newEt =
+    std::min(std::max(total, config_.minExposureTime), maxEt);
+  const double newGain = std::min(
+    std::max(linear_to_db(total / newEt), config_.minGain), config_.maxGain);
+  if (
+    std::abs(newEt - exposureTime_) <= SAME_EXPOSURE * exposureTime_ &&
+    std::abs(newGain - gain_) <= SAME_GAIN) {
+    return (false);  // at the limits already
+  }
+  exposureTime_ = newEt;
+  gain_ = newGain;
+  settling_ = true;
+  numSettleFrames_ = 0;
+  *exposureTime = newEt;
+  *gain = newGain;
+  return (true);
+}
+
+void ExposureController::run()
+{
+  const auto period = std::chrono::microseconds(static_cast<int64_t>(
+    1e6 / std::max(config_.maxUpdateRate, 0.1)));
+  uint64_t lastSample = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (keepRunning_) {
+    cv_.wait_for(lock, period);
+    // the producer does not take the mutex
+    Sample s;
+    const uint64_t seq = readSample(&s);
+    if (!keepRunning_ || seq == lastSample) {
+      continue;
+    }
+    // every addSample() advances the sequence by two
+    const uint64_t numFrames = (seq - lastSample) / 2;
+    lastSample = seq;
+    lock.unlock();
+    double et, gain;
+    if (update(s, numFrames, &et, &gain)) {
+      setter_(et, gain);
+    }
+    lock.lock();
+  }
+}
+}  // namespace flir_spinnaker_common
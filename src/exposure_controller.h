@@ -0,0 +1,95 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EXPOSURE_CONTROLLER_H_
+#define EXPOSURE_CONTROLLER_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace flir_spinnaker_common
+{
+//
+// Software auto exposure. The acquisition thread deposits the latest
+// brightness sample without locking, a separate thread runs the
+// control law at most maxUpdateRate times per second and writes the
+// camera through the setter. update() is free of side effects on the
+// camera, so it can be exercised against a simulated scene.
+//
+class ExposureController
+{
+public:
+  struct Sample
+  {
+    int16_t brightness{-1};  // 0..255
+    double exposureTime{0};  // usec, as used for the frame (0: unknown)
+    double gain{0};  // dB, as used for the frame
+    double maxExposureTime{0};  // usec, camera limit (0: unknown)
+  };
+  typedef std::function<void(double exposureTime, double gain)> Setter;
+
+  ExposureController(
+    const Driver::ExposureControlConfig & config, double exposureTime,
+    double gain);
+  ~ExposureController();
+  // launches the control thread
+  void start(const Setter & setter);
+  void stop();
+  // Called from the acquisition thread, does not touch the camera.
+  // Must not be called from more than one thread at a time.
+  void addSample(const Sample & s);
+  // Control law. numFrames is the number of frames that arrived since
+  // the previous call, including the one of sample s. Returns true if
+  // the exposure time and gain should be changed to the values returned.
+  bool update(
+    const Sample & s, uint64_t numFrames, double * exposureTime,
+    double * gain);
+
+private:
+  // slot for the latest sample, written by a single producer
+  struct SampleSlot
+  {
+    std::atomic<uint64_t> sequence{0};  // odd while being written
+    std::atomic<int16_t> brightness{-1};
+    std::atomic<double> exposureTime{0};
+    std::atomic<double> gain{0};
+    std::atomic<double> maxExposureTime{0};
+  };
+  void run();
+  // Returns the sequence number of the sample read, which changes with
+  // every addSample(). Retries while the producer is writing.
+  uint64_t readSample(Sample * s) const;
+  // ----- variables --
+  Driver::ExposureControlConfig config_;
+  double exposureTime_;  // last commanded values
+  double gain_;
+  bool settling_{false};  // waiting for frames with the new settings
+  uint64_t numSettleFrames_{0};
+  Setter setter_;
+  bool keepRunning_{false};
+  SampleSlot slot_;
+  std::mutex mutex_;  // for keepRunning_ and cv_
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // EXPOSURE_CONTROLLER_H_
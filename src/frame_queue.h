@@ -0,0 +1,114 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_QUEUE_H_
+#define FRAME_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+//
+// Bounded lock-free multi-producer multi-consumer ring buffer
+// (D. Vyukov's algorithm). Every cell carries a sequence number that
+// tells producers and consumers whose turn it is.
+//
+template <class T>
+class FrameQueue
+{
+public:
+  explicit FrameQueue(size_t capacity)
+  : capacity_(capacity > 0 ? capacity : 1), cells_(capacity_)
+  {
+    for (size_t i = 0; i < capacity_; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool tryPush(T && v)
+  {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell & c = cells_[pos % capacity_];
+      const size_t seq = c.sequence.load(std::memory_order_acquire);
+      const ptrdiff_t diff =
+        static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          c.data = std::move(v);
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return (true);
+        }
+      } else if (diff < 0) {
+        return (false);  // full
+      } else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool tryPop(T * v)
+  {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell & c = cells_[pos % capacity_];
+      const size_t seq = c.sequence.load(std::memory_order_acquire);
+      const ptrdiff_t diff =
+        static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          *v = std::move(c.data);
+          c.sequence.store(pos + capacity_, std::memory_order_release);
+          return (true);
+        }
+      } else if (diff < 0) {
+        return (false);  // empty
+      } else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // approximate when producers or consumers are active
+  size_t size() const
+  {
+    const size_t e = enqueuePos_.load(std::memory_order_relaxed);
+    const size_t d = dequeuePos_.load(std::memory_order_relaxed);
+    return (e > d ? e - d : 0);
+  }
+  size_t capacity() const { return (capacity_); }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+  // ----- variables --
+  const size_t capacity_;
+  std::vector<Cell> cells_;
+  char pad0_[64];  // keep the positions on separate cache lines
+  std::atomic<size_t> enqueuePos_{0};
+  char pad1_[64];
+  std::atomic<size_t> dequeuePos_{0};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // FRAME_QUEUE_H_
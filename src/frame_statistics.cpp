@@ -0,0 +1,208 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace flir_spinnaker_common
+{
+static void update_max(std::atomic<uint64_t> * m, uint64_t v)
+{
+  uint64_t old = m->load(std::memory_order_relaxed);
+  while (v > old && !m->compare_exchange_weak(old, v)) {
+  }
+}
+
+FrameStatistics::FrameStatistics() { reset(); }
+
+void FrameStatistics::reset()
+{
+  numFrames_ = 0;
+  numIncomplete_ = 0;
+  numIntervals_ = 0;
+  lastTime_ = 0;
+  lastInterval_ = 0;
+  windowedInterval_ = 0;
+  maxInterval_ = 0;
+  intervalSum_ = 0;
+  intervalSquareSum_ = 0;
+  numCallbacks_ = 0;
+  callbackTime_ = 0;
+  maxCallbackTime_ = 0;
+  numFrameIdGaps_ = 0;
+  numFramesMissing_ = 0;
+  numBufferLatencies_ = 0;
+  bufferLatency_ = 0;
+  maxBufferLatency_ = 0;
+  numDeliveries_ = 0;
+  deliveryLatency_ = 0;
+  maxDeliveryLatency_ = 0;
+  lastFrameId_ = 0;
+  resyncFrameId_ = false;
+  minOffset_ = UINT64_MAX;
+  prevMinOffset_ = UINT64_MAX;
+  for (auto & h : histogram_) {
+    h = 0;
+  }
+  window_.fill(0);
+  windowIndex_ = 0;
+}
+
+int FrameStatistics::get_bucket(uint64_t dt)
+{
+  if (dt < BUCKETS_PER_OCTAVE) {
+    return (static_cast<int>(dt));
+  }
+  const int msb = 63 - __builtin_clzll(dt);
+  const int sub = static_cast<int>((dt >> (msb - 2)) & 3);
+  return (msb * BUCKETS_PER_OCTAVE + sub);
+}
+
+// smallest interval that falls into the next bucket
+uint64_t FrameStatistics::get_bucket_limit(int bucket)
+{
+  if (bucket < 2 * BUCKETS_PER_OCTAVE) {
+    return (static_cast<uint64_t>(bucket) + 1);
+  }
+  const int msb = bucket / BUCKETS_PER_OCTAVE;
+  const uint64_t sub = static_cast<uint64_t>(bucket % BUCKETS_PER_OCTAVE);
+  const uint64_t limit = (4 + sub + 1) << (msb - 2);
+  return (limit == 0 ? UINT64_MAX : limit);  // top bucket wraps
+}
+
+void FrameStatistics::addFrame(
+  uint64_t t, uint64_t imageTime, uint64_t frameId, bool incomplete)
+{
+  if (imageTime != 0 && t > imageTime) {
+    // The clocks have an unknown offset, but the frame that got
+    // through the fastest sets a baseline for the others.
+    const uint64_t offset = t - imageTime;
+    minOffset_ = std::min(minOffset_, offset);
+    const uint64_t dt = offset - std::min(minOffset_, prevMinOffset_);
+    bufferLatency_.fetch_add(dt, std::memory_order_relaxed);
+    update_max(&maxBufferLatency_, dt);
+    const uint64_t n =
+      numBufferLatencies_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (n % OFFSET_WINDOW_SIZE == 0) {
+      prevMinOffset_ = minOffset_;
+      minOffset_ = UINT64_MAX;
+    }
+  }
+  const uint64_t last = lastTime_.load(std::memory_order_relaxed);
+  // A frame id that does not increase means the camera restarted
+  // counting (e.g. after an acquisition restart), not a gap.
+  if (last != 0 && !resyncFrameId_ && frameId > lastFrameId_ + 1) {
+    numFrameIdGaps_.fetch_add(1, std::memory_order_relaxed);
+    numFramesMissing_.fetch_add(
+      frameId - lastFrameId_ - 1, std::memory_order_relaxed);
+  }
+  lastFrameId_ = frameId;
+  resyncFrameId_ = false;
+  if (last != 0 && t > last) {
+    const uint64_t dt = t - last;
+    lastInterval_.store(dt, std::memory_order_relaxed);
+    histogram_[get_bucket(dt)].fetch_add(1, std::memory_order_relaxed);
+    update_max(&maxInterval_, dt);
+    const uint64_t us = dt / 1000;
+    intervalSum_.fetch_add(us, std::memory_order_relaxed);
+    intervalSquareSum_.fetch_add(us * us, std::memory_order_relaxed);
+    const uint64_t n = numIntervals_.fetch_add(1, std::memory_order_relaxed);
+    // window_ holds the last WINDOW_SIZE frame times
+    const uint64_t oldest =
+      n + 1 >= WINDOW_SIZE ? window_[windowIndex_] : window_[0];
+    const uint64_t numInWindow = std::min<uint64_t>(n + 1, WINDOW_SIZE);
+    windowedInterval_.store(
+      (t - oldest) / numInWindow, std::memory_order_relaxed);
+  }
+  if (last == 0) {
+    window_[0] = t;
+    windowIndex_ = 1;
+  } else {
+    window_[windowIndex_] = t;
+    windowIndex_ = (windowIndex_ + 1) % WINDOW_SIZE;
+  }
+  lastTime_.store(t, std::memory_order_relaxed);
+  numFrames_.fetch_add(1, std::memory_order_relaxed);
+  if (incomplete) {
+    numIncomplete_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FrameStatistics::addCallbackTime(uint64_t dt)
+{
+  callbackTime_.fetch_add(dt, std::memory_order_relaxed);
+  numCallbacks_.fetch_add(1, std::memory_order_relaxed);
+  update_max(&maxCallbackTime_, dt);
+}
+
+void FrameStatistics::addDeliveryLatency(uint64_t dt)
+{
+  deliveryLatency_.fetch_add(dt, std::memory_order_relaxed);
+  numDeliveries_.fetch_add(1, std::memory_order_relaxed);
+  update_max(&maxDeliveryLatency_, dt);
+}
+
+double FrameStatistics::getPercentile(double p, uint64_t total) const
+{
+  const uint64_t target = static_cast<uint64_t>(p * total);
+  uint64_t sum = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    sum += histogram_[i].load(std::memory_order_relaxed);
+    if (sum > target) {
+      return (std::min(get_bucket_limit(i), maxInterval_.load()) * 1e-9);
+    }
+  }
+  return (maxInterval_ * 1e-9);
+}
+
+void FrameStatistics::getFrameDrops(Driver::FrameDropStatistics * s) const
+{
+  s->numFramesReceived = numFrames_;
+  s->numFrameIdGaps = numFrameIdGaps_;
+  s->numFramesMissing = numFramesMissing_;
+  s->numIncomplete = numIncomplete_;
+}
+
+void FrameStatistics::getSnapshot(Driver::Statistics * s) const
+{
+  s->numFrames = numFrames_;
+  s->numIncomplete = numIncomplete_;
+  const uint64_t li = lastInterval_;
+  const uint64_t wi = windowedInterval_;
+  s->instantaneousFrameRate = li > 0 ? 1e9 / li : 0;
+  s->receiveFrameRate = wi > 0 ? 1e9 / wi : 0;
+  const uint64_t n = numIntervals_;
+  s->intervalP50 = n > 0 ? getPercentile(0.5, n) : 0;
+  s->intervalP99 = n > 0 ? getPercentile(0.99, n) : 0;
+  s->intervalMax = maxInterval_ * 1e-9;
+  if (n > 0) {
+    const double mean = static_cast<double>(intervalSum_) / n;
+    const double var =
+      static_cast<double>(intervalSquareSum_) / n - mean * mean;
+    s->intervalStdDev = std::sqrt(std::max(var, 0.0)) * 1e-6;
+  }
+  const uint64_t nc = numCallbacks_;
+  s->callbackTimeAvg = nc > 0 ? callbackTime_ * 1e-9 / nc : 0;
+  s->callbackTimeMax = maxCallbackTime_ * 1e-9;
+  const uint64_t nb = numBufferLatencies_;
+  s->bufferLatencyAvg = nb > 0 ? bufferLatency_ * 1e-9 / nb : 0;
+  s->bufferLatencyMax = maxBufferLatency_ * 1e-9;
+  const uint64_t nd = numDeliveries_;
+  s->deliveryLatencyAvg = nd > 0 ? deliveryLatency_ * 1e-9 / nd : 0;
+  s->deliveryLatencyMax = maxDeliveryLatency_ * 1e-9;
+}
+}  // namespace flir_spinnaker_common
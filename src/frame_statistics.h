@@ -0,0 +1,104 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_STATISTICS_H_
+#define FRAME_STATISTICS_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace flir_spinnaker_common
+{
+//
+// Frame timing statistics. Frames are added by a single thread (the
+// acquisition thread), callback times by any number of threads.
+// Snapshots can be taken from any thread at any time without locking,
+// but are not guaranteed to be consistent across fields.
+//
+class FrameStatistics
+{
+public:
+  FrameStatistics();
+  // Times are in nanoseconds. The image time comes from the camera
+  // clock, 0 if there is none.
+  void addFrame(
+    uint64_t t, uint64_t imageTime, uint64_t frameId, bool incomplete);
+  void addCallbackTime(uint64_t dt);
+  // from the arrival of a frame to the end of its callback
+  void addDeliveryLatency(uint64_t dt);
+  // must not run concurrently with the add methods
+  void reset();
+  // The next frame id does not count as a gap. For frames that are
+  // dropped on purpose, e.g. while the stream is paused. Must not run
+  // concurrently with addFrame().
+  void resyncFrameId() { resyncFrameId_ = true; }
+  uint64_t getLastTime() const { return (lastTime_); }
+  // fills in the timing fields of the statistics
+  void getSnapshot(Driver::Statistics * s) const;
+  // fills in the frame id and incomplete counts
+  void getFrameDrops(Driver::FrameDropStatistics * s) const;
+
+private:
+  // 4 buckets per octave, covering all 64 bit intervals
+  static const int BUCKETS_PER_OCTAVE = 4;
+  static const int NUM_BUCKETS = 64 * BUCKETS_PER_OCTAVE;
+  // number of frames for the windowed frame rate
+  static const size_t WINDOW_SIZE = 64;
+  // frames per window for the minimum clock offset
+  static const uint64_t OFFSET_WINDOW_SIZE = 1024;
+  static int get_bucket(uint64_t dt);
+  static uint64_t get_bucket_limit(int bucket);
+  double getPercentile(double p, uint64_t total) const;
+  // ----- variables --
+  std::atomic<uint64_t> numFrames_{0};
+  std::atomic<uint64_t> numIncomplete_{0};
+  std::atomic<uint64_t> numIntervals_{0};
+  std::atomic<uint64_t> lastTime_{0};
+  std::atomic<uint64_t> lastInterval_{0};
+  std::atomic<uint64_t> windowedInterval_{0};
+  std::atomic<uint64_t> maxInterval_{0};
+  // in usec, such that the squares do not overflow
+  std::atomic<uint64_t> intervalSum_{0};
+  std::atomic<uint64_t> intervalSquareSum_{0};
+  std::atomic<uint64_t> numCallbacks_{0};
+  std::atomic<uint64_t> callbackTime_{0};
+  std::atomic<uint64_t> maxCallbackTime_{0};
+  std::atomic<uint64_t> numFrameIdGaps_{0};
+  std::atomic<uint64_t> numFramesMissing_{0};
+  std::atomic<uint64_t> numBufferLatencies_{0};
+  std::atomic<uint64_t> bufferLatency_{0};
+  std::atomic<uint64_t> maxBufferLatency_{0};
+  std::atomic<uint64_t> numDeliveries_{0};
+  std::atomic<uint64_t> deliveryLatency_{0};
+  std::atomic<uint64_t> maxDeliveryLatency_{0};
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> histogram_;
+  // only touched by the thread calling addFrame()
+  std::array<uint64_t, WINDOW_SIZE> window_;
+  size_t windowIndex_{0};
+  uint64_t lastFrameId_{0};
+  bool resyncFrameId_{false};
+  // Smallest difference between arrival and camera time, over the
+  // current and the previous window, such that clock drift does not
+  // accumulate.
+  uint64_t minOffset_{UINT64_MAX};
+  uint64_t prevMinOffset_{UINT64_MAX};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // FRAME_STATISTICS_H_
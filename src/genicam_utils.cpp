@@ -98,5 +98,54 @@ CNodePtr find_node(
   CNodePtr retNode = find_node(path, rootNode, debug);
   return (retNode);
 }
+
+// guards against category loops in broken node maps
+static const int MAX_CATEGORY_DEPTH = 32;
+
+void NodeCache::addCategory(
+  CNodePtr node, const std::string & prefix, int depth)
+{
+  if (depth > MAX_CATEGORY_DEPTH) {
+    return;
+  }
+  CCategoryPtr catNode = static_cast<CCategoryPtr>(node);
+  FeatureList_t features;
+  catNode->GetFeatures(features);
+  for (auto it = features.begin(); it != features.end(); ++it) {
+    CNodePtr childNode = *it;
+    const std::string name(childNode->GetName().c_str());
+    const std::string path = prefix.empty() ? name : prefix + "/" + name;
+    nodes_.emplace(path, childNode);
+    // feature names are unique within a node map
+    nodes_.emplace(name, childNode);
+    if (childNode->GetPrincipalInterfaceType() == intfICategory) {
+      addCategory(childNode, path, depth + 1);
+    }
+  }
+}
+
+void NodeCache::build(Spinnaker::CameraPtr cam, bool debug)
+{
+  nodes_.clear();
+  CNodePtr rootNode = cam->GetNodeMap().GetNode("Root");
+  if (
+    !rootNode.IsValid() ||
+    rootNode->GetPrincipalInterfaceType() != intfICategory) {
+    std::cerr << "driver: cannot find root node, node cache is empty!"
+              << std::endl;
+    return;
+  }
+  addCategory(rootNode, "", 0);
+  if (debug) {
+    std::cout << "driver: node cache has " << nodes_.size() << " entries"
+              << std::endl;
+  }
+}
+
+CNodePtr NodeCache::find(const std::string & pathOrName) const
+{
+  auto it = nodes_.find(pathOrName);
+  return (it == nodes_.end() ? CNodePtr(NULL) : it->second);
+}
 }  // namespace genicam_utils
 }  // namespace flir_spinnaker_common
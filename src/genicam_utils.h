@@ -21,6 +21,7 @@
 
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 namespace flir_spinnaker_common
 {
@@ -29,6 +30,29 @@ namespace genicam_utils
 void get_nodemap_as_string(std::stringstream & ss, Spinnaker::CameraPtr cam);
 Spinnaker::GenApi::CNodePtr find_node(
   const std::string & path, Spinnaker::CameraPtr cam, bool debug);
+
+//
+// Index of all features reachable from the "Root" category, built
+// once by walking the category tree. Nodes can be looked up by path
+// relative to Root ("AnalogControl/Gain") or by bare name ("Gain").
+// The nodes belong to the camera's node map, so the cache must be
+// cleared before the camera is deinitialized.
+//
+class NodeCache
+{
+public:
+  void build(Spinnaker::CameraPtr cam, bool debug);
+  void clear() { nodes_.clear(); }
+  bool empty() const { return (nodes_.empty()); }
+  size_t size() const { return (nodes_.size()); }
+  // returns NULL node if not found
+  Spinnaker::GenApi::CNodePtr find(const std::string & pathOrName) const;
+
+private:
+  void addCategory(
+    Spinnaker::GenApi::CNodePtr node, const std::string & prefix, int depth);
+  std::unordered_map<std::string, Spinnaker::GenApi::CNodePtr> nodes_;
+};
 }  // namespace genicam_utils
 }  // namespace flir_spinnaker_common
 #endif  // GENICAM_UTILS_H_
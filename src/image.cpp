@@ -20,7 +20,8 @@ Image::Image(
   uint64_t t, int16_t brightness, uint32_t et, uint32_t maxEt, float gain,
   int64_t imgT, size_t imageSize, int status, const void * data, size_t w,
   size_t h, size_t stride, size_t bitsPerPixel, size_t numChan,
-  uint64_t frameId, pixel_format::PixelFormat pixFmt)
+  uint64_t frameId, pixel_format::PixelFormat pixFmt,
+  const std::shared_ptr<void> & bufferHolder)
 : time_(t),
   brightness_(brightness),
   exposureTime_(et),
@@ -36,7 +37,8 @@ Image::Image(
   bitsPerPixel_(bitsPerPixel),
   numChan_(numChan),
   frameId_(frameId),
-  pixelFormat_(pixFmt)
+  pixelFormat_(pixFmt),
+  bufferHolder_(bufferHolder)
 {
 }
 }  // namespace flir_spinnaker_common
@@ -0,0 +1,83 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_pool.h"
+
+#include <new>
+
+namespace flir_spinnaker_common
+{
+static const uint32_t END_OF_LIST = 0xFFFFFFFFu;
+
+static uint64_t make_head(uint64_t tag, uint32_t idx)
+{
+  return ((tag << 32) | idx);
+}
+
+static uint32_t head_index(uint64_t head)
+{
+  return (static_cast<uint32_t>(head & 0xFFFFFFFFu));
+}
+
+MemoryPool::MemoryPool(size_t blockSize, size_t numBlocks)
+: numBlocks_(numBlocks), next_(numBlocks)
+{
+  // round block size up so every block is suitably aligned
+  const size_t a = alignof(std::max_align_t);
+  blockSize_ = ((blockSize + a - 1) / a) * a;
+  memory_.reset(new uint8_t[blockSize_ * numBlocks_]);
+  for (size_t i = 0; i < numBlocks_; i++) {
+    next_[i] = (i + 1 < numBlocks_) ? static_cast<uint32_t>(i + 1)
+                                    : END_OF_LIST;
+  }
+  head_ = make_head(0, numBlocks_ > 0 ? 0 : END_OF_LIST);
+}
+
+void * MemoryPool::allocate(size_t bytes, size_t alignment)
+{
+  if (bytes <= blockSize_ && alignment <= alignof(std::max_align_t)) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (head_index(head) != END_OF_LIST) {
+      const uint32_t idx = head_index(head);
+      const uint64_t newHead =
+        make_head((head >> 32) + 1, next_[idx].load(std::memory_order_relaxed));
+      if (head_.compare_exchange_weak(
+            head, newHead, std::memory_order_acq_rel,
+            std::memory_order_acquire)) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return (memory_.get() + idx * blockSize_);
+      }
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return (::operator new(bytes));
+}
+
+void MemoryPool::deallocate(void * p)
+{
+  if (!owns(p)) {
+    ::operator delete(p);
+    return;
+  }
+  const uint32_t idx = static_cast<uint32_t>(
+    (static_cast<uint8_t *>(p) - memory_.get()) / blockSize_);
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  do {
+    next_[idx].store(head_index(head), std::memory_order_relaxed);
+  } while (!head_.compare_exchange_weak(
+    head, make_head((head >> 32) + 1, idx), std::memory_order_release,
+    std::memory_order_relaxed));
+}
+}  // namespace flir_spinnaker_common
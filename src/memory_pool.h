@@ -0,0 +1,98 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEMORY_POOL_H_
+#define MEMORY_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+//
+// Lock-free pool of fixed size memory blocks. Requests that are too
+// large or arrive when the pool is exhausted fall back to the heap
+// and are counted as misses.
+//
+class MemoryPool
+{
+public:
+  MemoryPool(size_t blockSize, size_t numBlocks);
+  void * allocate(size_t bytes, size_t alignment);
+  void deallocate(void * p);
+  uint64_t getHits() const { return (hits_); }
+  uint64_t getMisses() const { return (misses_); }
+  size_t getBlockSize() const { return (blockSize_); }
+
+private:
+  bool owns(const void * p) const
+  {
+    return (p >= memory_.get() && p < memory_.get() + blockSize_ * numBlocks_);
+  }
+  // ----- variables --
+  size_t blockSize_;
+  size_t numBlocks_;
+  std::unique_ptr<uint8_t[]> memory_;
+  std::vector<std::atomic<uint32_t>> next_;  // free list links
+  std::atomic<uint64_t> head_;  // ABA tag (upper 32) + block index (lower)
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+//
+// Allocator that draws from a MemoryPool, suitable for allocate_shared()
+// and for the control block of shared_ptrs with custom deleters. Each
+// copy keeps the pool alive, so objects may outlive their creator.
+//
+template <class T>
+class PoolAllocator
+{
+public:
+  typedef T value_type;
+  explicit PoolAllocator(const std::shared_ptr<MemoryPool> & pool)
+  : pool_(pool)
+  {
+  }
+  template <class U>
+  PoolAllocator(const PoolAllocator<U> & a) : pool_(a.pool_)  // NOLINT
+  {
+  }
+  T * allocate(size_t n)
+  {
+    return (static_cast<T *>(pool_->allocate(n * sizeof(T), alignof(T))));
+  }
+  void deallocate(T * p, size_t) { pool_->deallocate(p); }
+  template <class U>
+  bool operator==(const PoolAllocator<U> & a) const
+  {
+    return (pool_ == a.pool_);
+  }
+  template <class U>
+  bool operator!=(const PoolAllocator<U> & a) const
+  {
+    return (pool_ != a.pool_);
+  }
+
+private:
+  template <class U>
+  friend class PoolAllocator;
+  std::shared_ptr<MemoryPool> pool_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // MEMORY_POOL_H_
@@ -0,0 +1,227 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/multi_driver.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./system_wrapper.h"
+#include "./thread_pool.h"
+
+namespace flir_spinnaker_common
+{
+// Init() takes hundreds of msec per camera, most of it waiting for the
+// device. Too many at once can overwhelm a shared link or PoE switch.
+static const int DEFAULT_MAX_PARALLEL_INIT = 4;
+
+MultiDriver::MultiDriver() : system_(SystemWrapper::getInstance())
+{
+  if (!system_->hasCameraList()) {
+    system_->refreshCameraList();
+  }
+}
+
+MultiDriver::~MultiDriver()
+{
+  if (deviceCallbackId_ >= 0) {
+    system_->removeDeviceCallback(deviceCallbackId_);
+  }
+  stopCameras();
+  deInitCameras();
+}
+
+std::string MultiDriver::getLibraryVersion() const
+{
+  return (system_->getLibraryVersion());
+}
+
+void MultiDriver::refreshCameraList() { system_->refreshCameraList(); }
+
+std::vector<std::string> MultiDriver::getSerialNumbers() const
+{
+  return (system_->getSerialNumbers());
+}
+
+bool MultiDriver::initCameras(const std::vector<std::string> & serialNumbers)
+{
+  bool allOk = true;
+  for (const auto & r : initCameras(serialNumbers, DEFAULT_MAX_PARALLEL_INIT)) {
+    allOk = allOk && r.ok;
+  }
+  return (allOk);
+}
+
+std::vector<MultiDriver::InitResult> MultiDriver::initCameras(
+  const std::vector<std::string> & serialNumbers, int maxParallel)
+{
+  std::vector<InitResult> results(serialNumbers.size());
+  std::vector<std::shared_ptr<Driver>> drivers(serialNumbers.size());
+  std::vector<size_t> todo;
+  bool refresh = false;
+  for (size_t i = 0; i < serialNumbers.size(); i++) {
+    const std::string & sn = serialNumbers[i];
+    results[i].serialNumber = sn;
+    if (drivers_.count(sn) != 0) {
+      results[i].ok = true;  // already initialized
+      results[i].message = "OK";
+      continue;
+    }
+    refresh = refresh || !system_->findCamera(sn);
+    todo.push_back(i);
+  }
+  if (refresh) {
+    system_->refreshCameraList();  // maybe plugged in since
+  }
+  // Camera::Init() mostly waits for the device, so the threads are
+  // not taken from the processing pool.
+  const size_t numThreads = std::min(
+    todo.size(),
+    maxParallel > 0 ? static_cast<size_t>(maxParallel) : todo.size());
+  std::atomic<size_t> next{0};
+  auto initNext = [&](size_t, size_t) {
+    for (size_t k = next++; k < todo.size(); k = next++) {
+      const size_t i = todo[k];
+      InitResult & r = results[i];
+      const auto t0 = std::chrono::steady_clock::now();
+      try {
+        // all drivers share the system wrapper held by this object
+        std::shared_ptr<Driver> driver(new Driver());
+        driver->setConfigCache(configCacheConfig_);
+        if (deviceCallback_) {
+          // arrivals and removals come from this object already
+          const Driver::DeviceCallback cb = deviceCallback_;
+          driver->setDeviceCallback(
+            [cb](const std::string & sn, Driver::DeviceEvent e) {
+              if (
+                e != Driver::DEVICE_ARRIVED && e != Driver::DEVICE_REMOVED) {
+                cb(sn, e);
+              }
+            });
+        }
+        r.ok = driver->initCamera(r.serialNumber);
+        r.message = r.ok ? "OK" : "camera not found!";
+        if (r.ok) {
+          drivers[i] = driver;
+        }
+      } catch (const std::exception & e) {
+        r.message = e.what();
+      }
+      r.initTime = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+    }
+  };
+  if (numThreads > 1) {
+    // the calling thread is one of the workers
+    ThreadPool pool(static_cast<int>(numThreads) - 1);
+    pool.parallelFor(numThreads, 1, static_cast<int>(numThreads), initNext);
+  } else {
+    initNext(0, todo.size());
+  }
+  for (const size_t i : todo) {
+    if (drivers[i]) {
+      drivers_[serialNumbers[i]] = drivers[i];
+    } else {
+      std::cerr << "failed to initialize camera " << serialNumbers[i] << ": "
+                << results[i].message << std::endl;
+    }
+  }
+  return (results);
+}
+
+void MultiDriver::deInitCameras()
+{
+  for (auto & d : drivers_) {
+    d.second->deInitCamera();
+  }
+  drivers_.clear();
+}
+
+bool MultiDriver::startCameras(const Callback & cb)
+{
+  Driver::DeliveryConfig dc;
+  dc.mode = Driver::ASYNCHRONOUS;
+  return (startCameras(cb, dc));
+}
+
+bool MultiDriver::startCameras(
+  const Callback & cb, const Driver::DeliveryConfig & dc)
+{
+  bool allOk = true;
+  for (auto & d : drivers_) {
+    const std::string sn = d.first;
+    const bool ok = d.second->startCamera(
+      [cb, sn](const ImageConstPtr & img) { cb(sn, img); }, dc);
+    if (!ok) {
+      std::cerr << "failed to start camera " << sn << std::endl;
+      allOk = false;
+    }
+  }
+  return (allOk);
+}
+
+bool MultiDriver::stopCameras()
+{
+  bool allOk = true;
+  for (auto & d : drivers_) {
+    allOk = d.second->stopCamera() && allOk;
+  }
+  return (allOk);
+}
+
+void MultiDriver::setDeviceCallback(const Driver::DeviceCallback & cb)
+{
+  if (deviceCallbackId_ >= 0) {
+    system_->removeDeviceCallback(deviceCallbackId_);
+    deviceCallbackId_ = -1;
+  }
+  deviceCallback_ = cb;
+  if (cb) {
+    deviceCallbackId_ = system_->addDeviceCallback(
+      [cb](const std::string & serial, bool arrived) {
+        cb(serial, arrived ? Driver::DEVICE_ARRIVED : Driver::DEVICE_REMOVED);
+      });
+  }
+}
+
+void MultiDriver::setConfigCache(const Driver::ConfigCacheConfig & c)
+{
+  configCacheConfig_ = c;
+}
+
+std::shared_ptr<Driver> MultiDriver::getDriver(
+  const std::string & serialNumber) const
+{
+  auto it = drivers_.find(serialNumber);
+  return (it == drivers_.end() ? std::shared_ptr<Driver>() : it->second);
+}
+
+std::vector<MultiDriver::CameraStatistics> MultiDriver::getStatistics() const
+{
+  std::vector<CameraStatistics> stats;
+  for (const auto & d : drivers_) {
+    CameraStatistics s;
+    static_cast<Driver::Statistics &>(s) = d.second->getStatistics();
+    s.serialNumber = d.first;
+    stats.push_back(s);
+  }
+  return (stats);
+}
+}  // namespace flir_spinnaker_common
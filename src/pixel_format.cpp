@@ -22,35 +22,43 @@ namespace flir_spinnaker_common
 {
 namespace pixel_format
 {
-static const std::unordered_map<PixelFormat, std::string> fmt_2_string{
-  {{PixelFormat::Mono8, "Mono8"},
-   {PixelFormat::Mono10p, "Mono10p"},
-   {PixelFormat::Mono10Packed, "Mono10Packed"},
-   {PixelFormat::Mono12p, "Mono12p"},
-   {PixelFormat::Mono12Packed, "Mono12Packed"},
-   {PixelFormat::Mono16, "Mono16"},
-   {PixelFormat::RGB8, "RGB8"},
-   {PixelFormat::RGB8Packed, "RGB8Packed"},
-   {PixelFormat::BayerRG8, "BayerRG8"},
-   {PixelFormat::BayerRG10p, "BayerRG10p"},
-   {PixelFormat::BayerRG10Packed, "BayerRG10Packed"},
-   {PixelFormat::BayerRG12p, "BayerRG12p"},
-   {PixelFormat::BayerRG12Packed, "BayerRG12Packed"},
-   {PixelFormat::BayerRG16, "BayerRG16"},
-   {PixelFormat::BayerGR8, "BayerGR8"},
-   {PixelFormat::BayerGR16, "BayerGR16"},
-   {PixelFormat::BayerGB8, "BayerGB8"},
-   {PixelFormat::BayerGB16, "BayerGB16"},
-   {PixelFormat::BayerBG8, "BayerBG8"},
-   {PixelFormat::BayerBG16, "BayerBG16"},
-   {PixelFormat::YUV411Packed, "YUV411Packed"},
-   {PixelFormat::YUV422Packed, "YUV422Packed"},
-   {PixelFormat::YUV444Packed, "YUV444Packed"},
-   {PixelFormat::YCbCr8, "YCbCr8"},
-   {PixelFormat::YCbCr422_8, "YCbCr422_8"},
-   {PixelFormat::YCbCr411_8, "YCbCr411_8"},
-   {PixelFormat::BGR8, "BGR8"},
-   {PixelFormat::BGRa8, "BGRa8"}}};
+// indexed by PixelFormat
+static const char * const fmt_names[NUM_PIXEL_FORMATS] = {
+  "INVALID",
+  "Mono8",
+  "Mono10p",
+  "Mono10Packed",
+  "Mono12p",
+  "Mono12Packed",
+  "Mono16",
+  "RGB8",
+  "RGB8Packed",
+  "BayerRG8",
+  "BayerRG10p",
+  "BayerRG10Packed",
+  "BayerRG12p",
+  "BayerRG12Packed",
+  "BayerRG16",
+  "BayerGR8",
+  "BayerGR16",
+  "BayerGB8",
+  "BayerGB16",
+  "BayerBG8",
+  "BayerBG16",
+  "YUV411Packed",
+  "YUV422Packed",
+  "YUV444Packed",
+  "YCbCr8",
+  "YCbCr422_8",
+  "YCbCr411_8",
+  "BGR8",
+  "BGRa8"};
+static_assert(
+  NUM_PIXEL_FORMATS == 29, "update fmt_names and dispatch() for new formats");
+static_assert(
+  get_traits(BayerRG12p).bitsPerPixel == 12 &&
+    get_traits(BGRa8).numChannels == 4 && get_traits(BayerBG8).cfa == CFA_BG,
+  "pixel format traits table is broken");
 
 static const std::unordered_map<std::string, PixelFormat> string_2_fmt{
   {{"Mono8", Mono8},
@@ -90,8 +98,8 @@ PixelFormat from_nodemap_string(const std::string pixFmt)
 
 std::string to_string(PixelFormat f)
 {
-  auto it = fmt_2_string.find(f);
-  return (it == fmt_2_string.end() ? "INVALID" : it->second);
+  return (
+    (f >= 0 && f < NUM_PIXEL_FORMATS) ? fmt_names[f] : fmt_names[INVALID]);
 }
 
 }  // namespace pixel_format
@@ -0,0 +1,242 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/player.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+#include "buffer_pool.h"
+#include "delivery_queue.h"
+
+namespace flir_spinnaker_common
+{
+namespace chrono = std::chrono;
+
+static bool read_fully(int fd, void * p, size_t n, uint64_t off)
+{
+  uint8_t * b = static_cast<uint8_t *>(p);
+  while (n > 0) {
+    const ssize_t r = pread(fd, b, n, static_cast<off_t>(off));
+    if (r <= 0) {
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      return (false);
+    }
+    b += r;
+    n -= static_cast<size_t>(r);
+    off += static_cast<uint64_t>(r);
+  }
+  return (true);
+}
+
+static uint64_t get_time()
+{
+  return (chrono::duration_cast<chrono::nanoseconds>(
+            chrono::high_resolution_clock::now().time_since_epoch())
+            .count());
+}
+
+Player::Player(const Config & config) : config_(config) {}
+
+Player::~Player()
+{
+  stop();
+  closeFiles();
+}
+
+bool Player::open()
+{
+  const std::string name = config_.directory + "/" + config_.baseName + ".idx";
+  const int fd = ::open(name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "player: cannot open " << name << ": " << strerror(errno)
+              << std::endl;
+    return (false);
+  }
+  Recorder::IndexHeader h;
+  const bool ok = read_fully(fd, &h, sizeof(h), 0) &&
+                  h.magic == Recorder::INDEX_MAGIC &&
+                  h.version == Recorder::VERSION &&
+                  h.entrySize == sizeof(Recorder::IndexEntry);
+  index_.clear();
+  if (ok) {
+    Recorder::IndexEntry e;
+    uint64_t off = sizeof(h);
+    while (read_fully(fd, &e, sizeof(e), off)) {
+      index_.push_back(e);
+      off += sizeof(e);
+    }
+  } else {
+    std::cerr << "player: bad index file " << name << std::endl;
+  }
+  ::close(fd);
+  // the writer threads may have completed frames out of order
+  std::stable_sort(
+    index_.begin(), index_.end(),
+    [](const Recorder::IndexEntry & a, const Recorder::IndexEntry & b) {
+      return (a.time < b.time);
+    });
+  return (ok);
+}
+
+void Player::closeFiles()
+{
+  for (const auto & f : files_) {
+    ::close(f.second);
+  }
+  files_.clear();
+}
+
+bool Player::start(const Driver::Callback & cb)
+{
+  return (start(cb, Driver::DeliveryConfig()));
+}
+
+bool Player::start(
+  const Driver::Callback & cb, const Driver::DeliveryConfig & dc)
+{
+  if (running_ || index_.empty()) {
+    return (false);
+  }
+  if (thread_.joinable()) {
+    thread_.join();  // previous playback ran to the end
+  }
+  callback_ = cb;
+  bufferPool_ = std::make_shared<BufferPool>(dc.queueSize + 2);
+  std::atomic_store(
+    &queue_, dc.mode == Driver::ASYNCHRONOUS
+               ? std::make_shared<DeliveryQueue>(dc, cb)
+               : std::shared_ptr<DeliveryQueue>());
+  numDelivered_ = 0;
+  keepRunning_ = true;
+  running_ = true;
+  thread_ = std::thread(&Player::run, this);
+  return (true);
+}
+
+void Player::stop()
+{
+  keepRunning_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  const auto q = std::atomic_load(&queue_);
+  if (q) {
+    q->stop();
+  }
+}
+
+uint64_t Player::getNumDropped() const
+{
+  const auto q = std::atomic_load(&queue_);
+  return (q ? q->getNumDropped() : 0);
+}
+
+ImageConstPtr Player::readFrame(const Recorder::IndexEntry & e)
+{
+  const auto key = std::make_pair(e.writer, e.chunk);
+  auto it = files_.find(key);
+  if (it == files_.end()) {
+    const std::string name = config_.directory + "/" + config_.baseName +
+                             "_" + std::to_string(e.writer) + "_" +
+                             std::to_string(e.chunk) + ".raw";
+    const int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      std::cerr << "player: cannot open " << name << ": " << strerror(errno)
+                << std::endl;
+      return (ImageConstPtr());
+    }
+    it = files_.emplace(key, fd).first;
+  }
+  Recorder::RecordHeader h;
+  if (
+    !read_fully(it->second, &h, sizeof(h), e.offset) ||
+    h.magic != Recorder::RECORD_MAGIC ||
+    h.headerSize + h.imageSize > e.recordSize) {
+    std::cerr << "player: bad record for frame " << e.frameId << std::endl;
+    return (ImageConstPtr());
+  }
+  std::shared_ptr<uint8_t> buf = bufferPool_->get(h.imageSize);
+  if (!read_fully(
+        it->second, buf.get(), h.imageSize, e.offset + h.headerSize)) {
+    return (ImageConstPtr());
+  }
+  const uint64_t t = config_.restamp ? get_time() : h.time;
+  ImagePtr img = std::make_shared<Image>(
+    t, h.brightness, h.exposureTime, h.maxExposureTime, h.gain, h.imageTime,
+    h.imageSize, h.imageStatus, buf.get(), h.width, h.height, h.stride,
+    h.bitsPerPixel, h.numChannels, h.frameId,
+    static_cast<pixel_format::PixelFormat>(h.pixelFormat), buf);
+  img->offsetX_ = h.offsetX;
+  img->offsetY_ = h.offsetY;
+  if (h.correctedTime != 0) {
+    // keeps its distance to the (re)stamped arrival time
+    img->correctedTime_ = h.correctedTime + t - h.time;
+  }
+  return (img);
+}
+
+void Player::run()
+{
+  const auto q = std::atomic_load(&queue_);
+  const auto period = chrono::nanoseconds(
+    static_cast<int64_t>(1e9 / std::max(config_.frameRate, 1e-3)));
+  do {
+    const auto start = chrono::steady_clock::now();
+    const uint64_t firstTime = index_.front().time;
+    for (size_t i = 0; i < index_.size() && keepRunning_; i++) {
+      const Recorder::IndexEntry & e = index_[i];
+      switch (config_.pacing) {
+        case ORIGINAL:
+          std::this_thread::sleep_until(
+            start + chrono::nanoseconds(e.time - firstTime));
+          break;
+        case FIXED_RATE:
+          std::this_thread::sleep_until(start + period * i);
+          break;
+        case MAX_RATE:
+          break;
+      }
+      ImageConstPtr img = readFrame(e);
+      if (!img) {
+        continue;
+      }
+      if (q) {
+        q->push(img);
+      } else {
+        // must not end the playback thread
+        try {
+          callback_(img);
+        } catch (const std::exception & e) {
+          std::cerr << "image callback failed: " << e.what() << std::endl;
+        } catch (...) {
+          std::cerr << "image callback failed!" << std::endl;
+        }
+      }
+      numDelivered_++;
+    }
+  } while (config_.loop && keepRunning_);
+  running_ = false;
+}
+}  // namespace flir_spinnaker_common
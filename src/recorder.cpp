@@ -0,0 +1,371 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/recorder.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "buffer_pool.h"
+#include "delivery_queue.h"
+
+namespace flir_spinnaker_common
+{
+const size_t Recorder::ALIGNMENT;
+
+// how long close() waits for the queued frames to be written
+static const std::chrono::seconds MAX_DRAIN_TIME(10);
+
+static_assert(sizeof(Recorder::RecordHeader) == 128, "bad record header");
+static_assert(sizeof(Recorder::IndexEntry) == 48, "bad index entry");
+
+struct Recorder::Writer
+{
+  ~Writer() { free(buffer); }
+  int index{0};
+  int fd{-1};
+  int chunk{-1};
+  bool direct{false};  // fd is opened with O_DIRECT
+  uint64_t offset{0};  // next write position in the chunk
+  // aligned staging buffer: the header block, then the image data
+  // that cannot be written from the image buffer directly
+  uint8_t * buffer{nullptr};
+  size_t bufferSize{0};
+};
+
+static size_t align_up(size_t n)
+{
+  return ((n + Recorder::ALIGNMENT - 1) & ~(Recorder::ALIGNMENT - 1));
+}
+
+static bool is_aligned(const void * p)
+{
+  return (reinterpret_cast<uintptr_t>(p) % Recorder::ALIGNMENT == 0);
+}
+
+// writes all of it, retrying on short writes
+static bool write_fully(int fd, struct iovec * iov, int n, uint64_t off)
+{
+  while (n > 0) {
+    const ssize_t r = pwritev(fd, iov, n, static_cast<off_t>(off));
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (false);
+    }
+    off += static_cast<uint64_t>(r);
+    size_t done = static_cast<size_t>(r);
+    while (n > 0 && done >= iov->iov_len) {
+      done -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + done;
+      iov->iov_len -= done;
+    }
+  }
+  return (true);
+}
+
+Recorder::Recorder(const Config & config) : config_(config)
+{
+  config_.numWriterThreads = std::max(config_.numWriterThreads, 1);
+  config_.chunkSize = align_up(config_.chunkSize);
+}
+
+Recorder::~Recorder() { close(); }
+
+std::string Recorder::getChunkName(int writer, int chunk) const
+{
+  return (
+    config_.directory + "/" + config_.baseName + "_" + std::to_string(writer) +
+    "_" + std::to_string(chunk) + ".raw");
+}
+
+bool Recorder::open()
+{
+  if (std::atomic_load(&queue_)) {
+    return (false);
+  }
+  const std::string indexName =
+    config_.directory + "/" + config_.baseName + ".idx";
+  indexFd_ = ::open(indexName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (indexFd_ < 0) {
+    std::cerr << "recorder: cannot open " << indexName << ": "
+              << strerror(errno) << std::endl;
+    return (false);
+  }
+  const IndexHeader ih{INDEX_MAGIC, VERSION, sizeof(IndexEntry), 0};
+  // entries are appended at the file position, write() moves it
+  if (::write(indexFd_, &ih, sizeof(ih)) != sizeof(ih)) {
+    ::close(indexFd_);
+    indexFd_ = -1;
+    return (false);
+  }
+  writers_.clear();
+  freeWriters_.clear();
+  for (int i = 0; i < config_.numWriterThreads; i++) {
+    auto w = std::make_shared<Writer>();
+    w->index = i;
+    if (!openChunk(w.get())) {
+      for (auto & ow : writers_) {
+        closeChunk(ow.get());
+      }
+      writers_.clear();
+      ::close(indexFd_);
+      indexFd_ = -1;
+      return (false);
+    }
+    writers_.push_back(w);
+    freeWriters_.push_back(w.get());
+  }
+  // aligned, such that the copies are written without staging
+  copyPool_ = std::make_shared<BufferPool>(config_.queueSize, ALIGNMENT);
+  Driver::DeliveryConfig dc;
+  dc.mode = Driver::ASYNCHRONOUS;
+  dc.overflowPolicy = Driver::DROP_NEWEST;
+  dc.queueSize = config_.queueSize;
+  dc.numThreads = config_.numWriterThreads;
+  std::atomic_store(
+    &queue_, std::make_shared<DeliveryQueue>(
+               dc, [this](const ImageConstPtr & img) { writeRecord(img); }));
+  return (true);
+}
+
+void Recorder::close()
+{
+  const auto q =
+    std::atomic_exchange(&queue_, std::shared_ptr<DeliveryQueue>());
+  if (!q) {
+    return;
+  }
+  if (!q->drain(MAX_DRAIN_TIME)) {
+    std::cerr << "recorder: timed out writing the queued frames!" << std::endl;
+  }
+  // waits for the frames being written, discards what is left
+  const size_t numDiscarded = q->stop();
+  numDroppedClosed_ += q->getNumDropped() + numDiscarded;
+  for (auto & w : writers_) {
+    closeChunk(w.get());
+  }
+  writers_.clear();
+  freeWriters_.clear();
+  if (fdatasync(indexFd_) != 0) {
+    std::cerr << "recorder: cannot sync index: " << strerror(errno)
+              << std::endl;
+  }
+  ::close(indexFd_);
+  indexFd_ = -1;
+}
+
+bool Recorder::openChunk(Writer * w)
+{
+  w->chunk++;
+  w->offset = 0;
+  const std::string name = getChunkName(w->index, w->chunk);
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  w->fd = -1;
+  w->direct = false;
+#ifdef O_DIRECT
+  if (config_.directIO) {
+    w->fd = ::open(name.c_str(), flags | O_DIRECT, 0644);
+    w->direct = (w->fd >= 0);
+  }
+#endif
+  if (w->fd < 0) {  // e.g. tmpfs does not support O_DIRECT
+    w->fd = ::open(name.c_str(), flags, 0644);
+  }
+  if (w->fd < 0) {
+    std::cerr << "recorder: cannot open " << name << ": " << strerror(errno)
+              << std::endl;
+    return (false);
+  }
+  // reserve the space up front so the file system does not have to
+  // allocate blocks while recording
+  const int ret =
+    posix_fallocate(w->fd, 0, static_cast<off_t>(config_.chunkSize));
+  if (ret != 0) {
+    std::cerr << "recorder: cannot preallocate " << name << ": "
+              << strerror(ret) << std::endl;
+  }
+  return (true);
+}
+
+void Recorder::closeChunk(Writer * w)
+{
+  if (w->fd < 0) {
+    return;
+  }
+  // The data must be on disk before the file shrinks to it, else a
+  // crash can leave a chunk whose size covers blocks never written.
+  if (fdatasync(w->fd) != 0) {
+    std::cerr << "recorder: cannot sync chunk: " << strerror(errno)
+              << std::endl;
+  }
+  // give back the preallocated space that was not used
+  if (ftruncate(w->fd, static_cast<off_t>(w->offset)) != 0) {
+    std::cerr << "recorder: cannot truncate chunk: " << strerror(errno)
+              << std::endl;
+  }
+  ::close(w->fd);
+  w->fd = -1;
+}
+
+void Recorder::write(const ImageConstPtr & img)
+{
+  const auto q = std::atomic_load(&queue_);
+  if (!q) {
+    return;
+  }
+  if (img->bufferHolder_) {
+    q->push(img);
+    return;
+  }
+  // the data is only valid during the callback, make a copy
+  std::shared_ptr<uint8_t> buf = copyPool_->get(img->imageSize_);
+  memcpy(buf.get(), img->data_, img->imageSize_);
+  ImagePtr copy = std::make_shared<Image>(
+    img->time_, img->brightness_, img->exposureTime_, img->maxExposureTime_,
+    img->gain_, img->imageTime_, img->imageSize_, img->imageStatus_,
+    buf.get(), img->width_, img->height_, img->stride_, img->bitsPerPixel_,
+    img->numChan_, img->frameId_, img->pixelFormat_, buf);
+  copy->correctedTime_ = img->correctedTime_;
+  copy->offsetX_ = img->offsetX_;
+  copy->offsetY_ = img->offsetY_;
+  q->push(copy);
+}
+
+// runs on the writer threads
+void Recorder::writeRecord(const ImageConstPtr & img)
+{
+  Writer * w;
+  {
+    // there are as many writers as threads, one is always free
+    std::unique_lock<std::mutex> lock(writerMutex_);
+    w = freeWriters_.back();
+    freeWriters_.pop_back();
+  }
+  const size_t recordSize = ALIGNMENT + align_up(img->imageSize_);
+  const uint8_t * data = static_cast<const uint8_t *>(img->data_);
+  // O_DIRECT needs aligned memory, other image buffers are staged
+  const size_t unstaged = (!w->direct || is_aligned(data))
+                          ? img->imageSize_ & ~(ALIGNMENT - 1)
+                          : 0;
+  const size_t staged = img->imageSize_ - unstaged;
+  const size_t bufferSize = ALIGNMENT + align_up(staged);
+  if (bufferSize > w->bufferSize) {
+    free(w->buffer);
+    w->buffer = nullptr;
+    w->bufferSize = 0;
+    void * p;
+    if (posix_memalign(&p, ALIGNMENT, bufferSize) == 0) {
+      w->buffer = static_cast<uint8_t *>(p);
+      w->bufferSize = bufferSize;
+      memset(w->buffer, 0, ALIGNMENT);  // header block padding
+    }
+  }
+  bool ok = (w->buffer != nullptr && w->fd >= 0);
+  if (ok && w->offset + recordSize > config_.chunkSize && w->offset > 0) {
+    closeChunk(w);
+    ok = openChunk(w);
+  }
+  if (ok) {
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RECORD_MAGIC;
+    h.version = VERSION;
+    h.headerSize = ALIGNMENT;
+    h.pixelFormat = static_cast<uint32_t>(img->pixelFormat_);
+    h.frameId = img->frameId_;
+    h.time = img->time_;
+    h.imageTime = img->imageTime_;
+    h.imageSize = img->imageSize_;
+    h.width = static_cast<uint32_t>(img->width_);
+    h.height = static_cast<uint32_t>(img->height_);
+    h.stride = static_cast<uint32_t>(img->stride_);
+    h.bitsPerPixel = static_cast<uint32_t>(img->bitsPerPixel_);
+    h.numChannels = static_cast<uint32_t>(img->numChan_);
+    h.imageStatus = img->imageStatus_;
+    h.exposureTime = img->exposureTime_;
+    h.maxExposureTime = img->maxExposureTime_;
+    h.gain = img->gain_;
+    h.brightness = img->brightness_;
+    h.correctedTime = img->correctedTime_;
+    h.offsetX = static_cast<uint32_t>(img->offsetX_);
+    h.offsetY = static_cast<uint32_t>(img->offsetY_);
+    memcpy(w->buffer, &h, sizeof(h));
+    // the bulk of the image goes to disk straight from its buffer
+    struct iovec iov[3];
+    int n = 0;
+    iov[n++] = {w->buffer, ALIGNMENT};
+    if (unstaged > 0) {
+      iov[n++] = {const_cast<uint8_t *>(data), unstaged};
+    }
+    if (staged > 0) {
+      uint8_t * tail = w->buffer + ALIGNMENT;
+      memcpy(tail, data + unstaged, staged);
+      memset(tail + staged, 0, align_up(staged) - staged);
+      iov[n++] = {tail, align_up(staged)};
+    }
+    ok = write_fully(w->fd, iov, n, w->offset);
+  }
+  if (ok) {
+    const IndexEntry e{img->frameId_,
+                       img->time_,
+                       img->imageTime_,
+                       static_cast<uint32_t>(w->index),
+                       static_cast<uint32_t>(w->chunk),
+                       w->offset,
+                       recordSize};
+    w->offset += recordSize;
+    {
+      std::unique_lock<std::mutex> lock(indexMutex_);
+      ok = (::write(indexFd_, &e, sizeof(e)) == sizeof(e));
+    }
+  }
+  if (ok) {
+    numWritten_++;
+    bytesWritten_ += recordSize;
+  } else {
+    numErrors_++;
+  }
+  std::unique_lock<std::mutex> lock(writerMutex_);
+  freeWriters_.push_back(w);
+}
+
+Recorder::Statistics Recorder::getStatistics() const
+{
+  Statistics s;
+  s.numWritten = numWritten_;
+  s.bytesWritten = bytesWritten_;
+  s.numErrors = numErrors_;
+  s.numDropped = numDroppedClosed_;
+  const auto q = std::atomic_load(&queue_);
+  if (q) {
+    s.numDropped += q->getNumDropped();
+    s.queueDepth = q->getDepth();
+  }
+  return (s);
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,560 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spinnaker_camera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "thread_setup.h"
+
+namespace flir_spinnaker_common
+{
+namespace GenApi = Spinnaker::GenApi;
+namespace GenICam = Spinnaker::GenICam;
+
+// msec, how long the polling thread waits for a frame at a time
+static const uint64_t POLL_TIMEOUT_MS = 100;
+
+template <class T>
+static bool is_available(T ptr)
+{
+  return (ptr.IsValid() && GenApi::IsAvailable(ptr));
+}
+
+template <class T>
+static bool is_writable(T ptr)
+{
+  return (ptr.IsValid() && GenApi::IsAvailable(ptr) && GenApi::IsWritable(ptr));
+}
+
+template <class T>
+static bool is_readable(T ptr)
+{
+  return (ptr.IsValid() && GenApi::IsAvailable(ptr) && GenApi::IsReadable(ptr));
+}
+
+static bool common_checks(
+  const GenApi::CNodePtr & np, const std::string & nodeName, std::string * msg)
+{
+  if (!np.IsValid()) {
+    *msg = "node " + nodeName + " does not exist!";
+    return (false);
+  }
+  if (!is_available(np)) {
+    *msg = "node " + nodeName + " not available!";
+    return (false);
+  }
+  if (!is_writable(np)) {
+    *msg = "node " + nodeName + " not available!";
+    return (false);
+  }
+  return (true);
+}
+
+static bool set_enum_value(
+  GenApi::INodeMap & nodeMap, const std::string & node,
+  const std::string & val)
+{
+  GenApi::CEnumerationPtr p = nodeMap.GetNode(node.c_str());
+  if (!is_writable(p)) {
+    return (false);
+  }
+  GenApi::CEnumEntryPtr entry = p->GetEntryByName(val.c_str());
+  if (!is_readable(entry)) {
+    return (false);
+  }
+  p->SetIntValue(entry->GetValue());
+  return (true);
+}
+
+// returns -1 if none of the counters is available
+static int64_t get_stream_counter(
+  GenApi::INodeMap & nodeMap, const char * name,
+  const char * altName = nullptr)
+{
+  GenApi::CIntegerPtr p = nodeMap.GetNode(name);
+  if (!is_readable(p) && altName) {
+    p = nodeMap.GetNode(altName);
+  }
+  return (is_readable(p) ? p->GetValue() : -1);
+}
+
+// Deleter for the shared pointer that keeps a Spinnaker buffer alive.
+// Hands the buffer back to the stream once the last Image using it is gone.
+struct BufferReleaser
+{
+  void operator()(void *)
+  {
+    try {
+      if (image->IsInUse()) {
+        image->Release();
+      }
+    } catch (const Spinnaker::Exception & e) {
+      // camera may have been deinitialized in the meantime
+      std::cerr << "WARNING: failed to release image: " << e.what()
+                << std::endl;
+    }
+    (*numHeld)--;
+  }
+  Spinnaker::ImagePtr image;
+  std::shared_ptr<std::atomic<int>> numHeld;
+};
+
+// what CameraFrame::handle points to
+struct SpinnakerCamera::FrameHandle
+{
+  Spinnaker::ImagePtr image;
+  bool held;  // by a BufferReleaser, which hands it back to the stream
+};
+
+SpinnakerCamera::SpinnakerCamera(Spinnaker::CameraPtr cam) : camera_(cam) {}
+
+SpinnakerCamera::~SpinnakerCamera()
+{
+  nodeCache_.clear();
+  camera_ = 0;  // call destructor, may not be needed
+}
+
+void SpinnakerCamera::init()
+{
+  camera_->Init();
+  nodeCache_.build(camera_, debug_);
+  exposureTimeNode_ = findNode("ExposureTime");
+  gainNode_ = findNode("Gain");
+}
+
+void SpinnakerCamera::deInit()
+{
+  // the cached nodes point into the node map that DeInit() destroys
+  nodeCache_.clear();
+  exposureTimeNode_ = GenApi::CFloatPtr();
+  gainNode_ = GenApi::CFloatPtr();
+  camera_->DeInit();
+}
+
+void SpinnakerCamera::startAcquisition(FrameHandler * handler)
+{
+  handler_ = handler;
+  if (threadConfig_.mode == Driver::POLLING_THREAD) {
+    camera_->BeginAcquisition();
+    keepPolling_ = true;
+    pollThread_ = std::thread(&SpinnakerCamera::poll, this);
+  } else {
+    camera_->RegisterEventHandler(*this);
+    camera_->BeginAcquisition();
+  }
+}
+
+void SpinnakerCamera::stopAcquisition()
+{
+  if (pollThread_.joinable()) {
+    stopPolling();
+    camera_->EndAcquisition();
+  } else {
+    try {
+      camera_->EndAcquisition();  // before unregistering the event handler!
+    } catch (const Spinnaker::Exception &) {
+      // device is gone, the SDK must not keep a pointer to us
+      camera_->UnregisterEventHandler(*this);
+      handler_ = nullptr;
+      throw;
+    }
+    camera_->UnregisterEventHandler(*this);
+  }
+  handler_ = nullptr;
+}
+
+void SpinnakerCamera::restartAcquisition()
+{
+  // the polling thread must not be in GetNextImage() meanwhile
+  const bool polling = pollThread_.joinable();
+  if (polling) {
+    stopPolling();
+  }
+  camera_->EndAcquisition();
+  camera_->BeginAcquisition();
+  if (polling) {
+    keepPolling_ = true;
+    pollThread_ = std::thread(&SpinnakerCamera::poll, this);
+  }
+}
+
+void SpinnakerCamera::stopPolling()
+{
+  keepPolling_ = false;
+  pollThread_.join();
+}
+
+void SpinnakerCamera::OnImageEvent(Spinnaker::ImagePtr imgPtr)
+{
+  FrameHandle h{imgPtr, false};
+  deliver(&h);
+}
+
+void SpinnakerCamera::poll()
+{
+  thread_setup::apply(threadConfig_, "acquisition thread");
+  while (keepPolling_) {
+    FrameHandle h{Spinnaker::ImagePtr(), false};
+    try {
+      // the timeout bounds the time stopPolling() has to wait
+      h.image = camera_->GetNextImage(POLL_TIMEOUT_MS);
+    } catch (const Spinnaker::Exception & e) {
+      if (e.GetError() != Spinnaker::SPINNAKER_ERR_TIMEOUT) {
+        std::cerr << "WARNING: GetNextImage() failed: " << e.what()
+                  << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      continue;
+    }
+    deliver(&h);
+    if (!h.held) {
+      try {
+        h.image->Release();
+      } catch (const Spinnaker::Exception & e) {
+        std::cerr << "WARNING: failed to release image: " << e.what()
+                  << std::endl;
+      }
+    }
+  }
+}
+
+void SpinnakerCamera::deliver(FrameHandle * h)
+{
+  const Spinnaker::ImagePtr & imgPtr = h->image;
+  CameraFrame f;
+  f.frameId = imgPtr->GetFrameID();
+  f.status = imgPtr->GetImageStatus();
+  f.incomplete = imgPtr->IsIncomplete();
+  if (!f.incomplete) {
+    const Spinnaker::ChunkData & chunk = imgPtr->GetChunkData();
+    f.exposureTime = chunk.GetExposureTime();
+    f.gain = chunk.GetGain();
+    f.imageTime = chunk.GetTimestamp();
+    f.maxExposureTime = static_cast<uint32_t>(
+      is_readable(exposureTimeNode_) ? exposureTimeNode_->GetMax() : 0);
+    f.data = imgPtr->GetData();
+    f.imageSize = imgPtr->GetImageSize();
+    f.width = imgPtr->GetWidth();
+    f.height = imgPtr->GetHeight();
+    f.stride = imgPtr->GetStride();
+    f.offsetX = imgPtr->GetXOffset();
+    f.offsetY = imgPtr->GetYOffset();
+    f.bitsPerPixel = imgPtr->GetBitsPerPixel();
+    f.numChannels = imgPtr->GetNumChannels();
+  }
+  f.handle = h;
+  handler_->onFrame(f);
+}
+
+std::shared_ptr<void> SpinnakerCamera::holdFrame(
+  const CameraFrame & frame, const std::shared_ptr<std::atomic<int>> & numHeld,
+  const PoolAllocator<Image> & alloc)
+{
+  FrameHandle * h = static_cast<FrameHandle *>(frame.handle);
+  h->held = true;
+  return (std::shared_ptr<void>(
+    h->image->GetData(), BufferReleaser{h->image, numHeld}, alloc));
+}
+
+std::string SpinnakerCamera::getStatusDescription(int status) const
+{
+  return (Spinnaker::Image::GetImageStatusDescription(
+    static_cast<Spinnaker::ImageStatus>(status)));
+}
+
+GenApi::CNodePtr SpinnakerCamera::findNode(const std::string & nodeName) const
+{
+  GenApi::CNodePtr np = nodeCache_.find(nodeName);
+  if (!np.IsValid() && debug_) {
+    std::cerr << "driver: node not found: " << nodeName << std::endl;
+  }
+  return (np);
+}
+
+std::string SpinnakerCamera::setEnum(
+  const std::string & nodeName, const std::string & val, std::string * retVal)
+{
+  *retVal = "UNKNOWN";
+  GenApi::CNodePtr np = findNode(nodeName);
+  std::string msg;
+  if (!common_checks(np, nodeName, &msg)) {
+    return (msg);
+  }
+  GenApi::CEnumerationPtr p = static_cast<GenApi::CEnumerationPtr>(np);
+  if (!is_writable(p)) {
+    return ("node " + nodeName + " not enum???");
+  }
+  // find integer corresponding to the enum string
+  GenApi::CEnumEntryPtr setVal = p->GetEntryByName(val.c_str());
+  if (!is_readable(setVal)) {
+    // bad enum value, try to read current value nevertheless
+    if (is_readable(p)) {
+      auto ce = p->GetCurrentEntry();
+      if (ce) {
+        *retVal = ce->GetSymbolic().c_str();
+      }
+    }
+    if (debug_) {
+      std::cout << "node " << nodeName << " invalid enum: " << val << std::endl;
+      std::cout << "allowed enum values: " << std::endl;
+      GenApi::StringList_t validValues;
+      p->GetSymbolics(validValues);
+      for (const auto & ve : validValues) {
+        std::cout << "  " << ve << std::endl;
+      }
+    }
+    return ("node " + nodeName + " invalid enum: " + val);
+  }
+  // set the new enum value
+  p->SetIntValue(setVal->GetValue());
+  // read it back
+  if (is_readable(p)) {
+    auto ce = p->GetCurrentEntry();
+    if (ce) {
+      *retVal = ce->GetSymbolic().c_str();
+    } else {
+      return ("node " + nodeName + " current entry not readable!");
+    }
+  } else {
+    return ("node " + nodeName + " is not readable!");
+  }
+  return ("OK");
+}
+
+template <class T>
+T set_invalid()
+{
+  return (std::nan(""));
+}
+
+template <>
+int set_invalid()
+{
+  return (-1);
+}
+
+template <class T1, class T2>
+static std::string set_parameter(
+  const std::string & nodeName, T2 val, T2 * retVal, GenApi::CNodePtr np)
+{
+  *retVal = set_invalid<T2>();
+  std::string msg;
+  if (!common_checks(np, nodeName, &msg)) {
+    return (msg);
+  }
+  T1 p = static_cast<T1>(np);
+  p->SetValue(val);
+  if (!is_readable(np)) {
+    return ("node " + nodeName + " current entry not readable!");
+  }
+  *retVal = p->GetValue();
+  return ("OK");
+}
+
+std::string SpinnakerCamera::setDouble(
+  const std::string & nn, double val, double * retVal)
+{
+  *retVal = std::nan("");
+  return (
+    set_parameter<GenApi::CFloatPtr, double>(nn, val, retVal, findNode(nn)));
+}
+
+std::string SpinnakerCamera::setBool(
+  const std::string & nn, bool val, bool * retVal)
+{
+  *retVal = !val;
+  return (
+    set_parameter<GenApi::CBooleanPtr, bool>(nn, val, retVal, findNode(nn)));
+}
+
+std::string SpinnakerCamera::setInt(
+  const std::string & nn, int val, int * retVal)
+{
+  *retVal = -1;
+  return (
+    set_parameter<GenApi::CIntegerPtr, int>(nn, val, retVal, findNode(nn)));
+}
+
+bool SpinnakerCamera::getEnum(const std::string & nodeName, std::string * val)
+{
+  GenApi::CEnumerationPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  auto ce = p->GetCurrentEntry();
+  if (!ce) {
+    return (false);
+  }
+  *val = ce->GetSymbolic().c_str();
+  return (true);
+}
+
+bool SpinnakerCamera::getDouble(const std::string & nodeName, double * val)
+{
+  GenApi::CFloatPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  *val = p->GetValue();
+  return (true);
+}
+
+bool SpinnakerCamera::getInt(const std::string & nodeName, int64_t * val)
+{
+  GenApi::CIntegerPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  *val = p->GetValue();
+  return (true);
+}
+
+bool SpinnakerCamera::getBool(const std::string & nodeName, bool * val)
+{
+  GenApi::CBooleanPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  *val = p->GetValue();
+  return (true);
+}
+
+bool SpinnakerCamera::getString(const std::string & nodeName, std::string * val)
+{
+  GenApi::CStringPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  *val = p->GetValue().c_str();
+  return (true);
+}
+
+bool SpinnakerCamera::getIntLimits(
+  const std::string & nodeName, int64_t * min, int64_t * max, int64_t * inc)
+{
+  GenApi::CIntegerPtr p = findNode(nodeName);
+  if (!is_readable(p)) {
+    return (false);
+  }
+  *min = p->GetMin();
+  *max = p->GetMax();
+  *inc = std::max(p->GetInc(), int64_t(1));
+  return (true);
+}
+
+bool SpinnakerCamera::execute(const std::string & nodeName)
+{
+  GenApi::CCommandPtr p = findNode(nodeName);
+  if (!is_writable(p)) {
+    return (false);
+  }
+  p->Execute();
+  return (true);
+}
+
+bool SpinnakerCamera::isLocked(const std::string & nodeName)
+{
+  GenApi::CNodePtr np = findNode(nodeName);
+  return (np.IsValid() && is_available(np) && !is_writable(np));
+}
+
+bool SpinnakerCamera::setExposure(double et, double gain)
+{
+  if (!is_writable(exposureTimeNode_)) {
+    return (false);
+  }
+  exposureTimeNode_->SetValue(std::min(
+    std::max(et, exposureTimeNode_->GetMin()), exposureTimeNode_->GetMax()));
+  if (is_writable(gainNode_)) {
+    gainNode_->SetValue(
+      std::min(std::max(gain, gainNode_->GetMin()), gainNode_->GetMax()));
+  }
+  return (true);
+}
+
+std::string SpinnakerCamera::getNodeMapAsString()
+{
+  std::stringstream ss;
+  genicam_utils::get_nodemap_as_string(ss, camera_);
+  return (ss.str());
+}
+
+int64_t SpinnakerCamera::getStreamBufferCount()
+{
+  GenApi::INodeMap & nodeMap = camera_->GetTLStreamNodeMap();
+  GenApi::CIntegerPtr result = nodeMap.GetNode("StreamBufferCountResult");
+  if (is_readable(result)) {
+    return (result->GetValue());
+  }
+  return (getDefaultStreamBufferCount());
+}
+
+int64_t SpinnakerCamera::getDefaultStreamBufferCount()
+{
+  GenApi::INodeMap & nodeMap = camera_->GetTLStreamNodeMap();
+  GenApi::CIntegerPtr defCount = nodeMap.GetNode("StreamDefaultBufferCount");
+  return (is_readable(defCount) ? defCount->GetValue() : 10);
+}
+
+bool SpinnakerCamera::setStreamBufferCount(int64_t n)
+{
+  GenApi::INodeMap & nodeMap = camera_->GetTLStreamNodeMap();
+  GenApi::CIntegerPtr count = nodeMap.GetNode("StreamBufferCountManual");
+  if (
+    !is_writable(count) ||
+    !set_enum_value(nodeMap, "StreamBufferCountMode", "Manual")) {
+    return (false);
+  }
+  n = std::min(std::max(n, count->GetMin()), count->GetMax());
+  count->SetValue(n);
+  if (debug_) {
+    std::cout << "stream buffer count set to " << n << std::endl;
+  }
+  return (true);
+}
+
+bool SpinnakerCamera::setStreamBufferHandling(const std::string & mode)
+{
+  GenApi::INodeMap & nodeMap = camera_->GetTLStreamNodeMap();
+  if (!set_enum_value(nodeMap, "StreamBufferHandlingMode", mode)) {
+    return (false);
+  }
+  if (debug_) {
+    std::cout << "stream buffer handling set to " << mode << std::endl;
+  }
+  return (true);
+}
+
+void SpinnakerCamera::getStreamStatistics(Driver::FrameDropStatistics * s)
+{
+  GenApi::INodeMap & nodeMap = camera_->GetTLStreamNodeMap();
+  s->streamLostFrameCount =
+    get_stream_counter(nodeMap, "StreamLostFrameCount");
+  s->streamDroppedFrameCount =
+    get_stream_counter(nodeMap, "StreamDroppedFrameCount");
+  s->streamBufferUnderrunCount =
+    get_stream_counter(nodeMap, "StreamBufferUnderrunCount");
+  s->streamIncompleteFrameCount =
+    get_stream_counter(nodeMap, "StreamIncompleteFrameCount");
+  s->streamResendRequestCount = get_stream_counter(
+    nodeMap, "StreamPacketResendRequestCount", "GevResendRequestCount");
+}
+}  // namespace flir_spinnaker_common
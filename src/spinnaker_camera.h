@@ -0,0 +1,101 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SPINNAKER_CAMERA_H_
+#define SPINNAKER_CAMERA_H_
+
+#include <SpinGenApi/SpinnakerGenApi.h>
+#include <Spinnaker.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "camera.h"
+#include "genicam_utils.h"
+
+namespace flir_spinnaker_common
+{
+//
+// Camera backed by the Spinnaker SDK. Frames arrive on the SDK's
+// event thread, or on a thread of our own that polls GetNextImage().
+//
+class SpinnakerCamera : public Camera, public Spinnaker::ImageEventHandler
+{
+public:
+  explicit SpinnakerCamera(Spinnaker::CameraPtr cam);
+  ~SpinnakerCamera();
+  // from ImageEventHandler
+  void OnImageEvent(Spinnaker::ImagePtr image) override;
+
+  void init() override;
+  void deInit() override;
+  void startAcquisition(FrameHandler * handler) override;
+  void stopAcquisition() override;
+  void restartAcquisition() override;
+  std::shared_ptr<void> holdFrame(
+    const CameraFrame & frame,
+    const std::shared_ptr<std::atomic<int>> & numHeld,
+    const PoolAllocator<Image> & alloc) override;
+  std::string getStatusDescription(int status) const override;
+
+  std::string setEnum(
+    const std::string & nodeName, const std::string & val,
+    std::string * retVal) override;
+  std::string setDouble(
+    const std::string & nodeName, double val, double * retVal) override;
+  std::string setInt(
+    const std::string & nodeName, int val, int * retVal) override;
+  std::string setBool(
+    const std::string & nodeName, bool val, bool * retVal) override;
+  bool getEnum(const std::string & nodeName, std::string * val) override;
+  bool getDouble(const std::string & nodeName, double * val) override;
+  bool getInt(const std::string & nodeName, int64_t * val) override;
+  bool getBool(const std::string & nodeName, bool * val) override;
+  bool getString(const std::string & nodeName, std::string * val) override;
+  bool getIntLimits(
+    const std::string & nodeName, int64_t * min, int64_t * max,
+    int64_t * inc) override;
+  bool execute(const std::string & nodeName) override;
+  bool isLocked(const std::string & nodeName) override;
+  bool setExposure(double exposureTime, double gain) override;
+  std::string getNodeMapAsString() override;
+
+  int64_t getStreamBufferCount() override;
+  int64_t getDefaultStreamBufferCount() override;
+  bool setStreamBufferCount(int64_t count) override;
+  bool setStreamBufferHandling(const std::string & mode) override;
+  void getStreamStatistics(Driver::FrameDropStatistics * s) override;
+
+private:
+  struct FrameHandle;
+  Spinnaker::GenApi::CNodePtr findNode(const std::string & nodeName) const;
+  void poll();
+  void stopPolling();
+  void deliver(FrameHandle * h);
+  // ----- variables --
+  Spinnaker::CameraPtr camera_;
+  genicam_utils::NodeCache nodeCache_;
+  Spinnaker::GenApi::CFloatPtr exposureTimeNode_;
+  Spinnaker::GenApi::CFloatPtr gainNode_;
+  FrameHandler * handler_{nullptr};
+  std::thread pollThread_;
+  std::atomic<bool> keepPolling_{false};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // SPINNAKER_CAMERA_H_
@@ -0,0 +1,833 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "synthetic_camera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "thread_setup.h"
+
+namespace flir_spinnaker_common
+{
+namespace chrono = std::chrono;
+using pixel_format::PixelFormat;
+
+static const int STATUS_INCOMPLETE = 1;
+static const double DEFAULT_EXPOSURE_TIME = 5000;  // usec
+static const double MIN_SIZE = 8;
+static const int64_t MAX_BUFFERS = 1000;
+static const char FIRMWARE_VERSION[] = "1.0.0";
+
+// Byte sequence of one group of pixels. G: gray value of the pixel,
+// Y: luma of the next pixel in the group, C: neutral chroma,
+// A: opaque alpha.
+struct GroupPattern
+{
+  const char * bytes;
+  size_t numPixels;
+};
+
+static GroupPattern get_group_pattern(pixel_format::ChannelLayout l)
+{
+  switch (l) {
+    case pixel_format::LAYOUT_RGB:
+    case pixel_format::LAYOUT_BGR:
+      return {"GGG", 1};
+    case pixel_format::LAYOUT_BGRA:
+      return {"GGGA", 1};
+    case pixel_format::LAYOUT_UYYVYY:
+      return {"CYYCYY", 4};
+    case pixel_format::LAYOUT_UYVY:
+      return {"CYCY", 2};
+    case pixel_format::LAYOUT_UYV:
+      return {"CYC", 1};
+    case pixel_format::LAYOUT_YCBCR:
+      return {"YCC", 1};
+    case pixel_format::LAYOUT_YCBYCR:
+      return {"YCYC", 2};
+    case pixel_format::LAYOUT_YYCBYYCR:
+      return {"YYCYYC", 4};
+    default:
+      return {"G", 1};  // mono and Bayer
+  }
+}
+
+static size_t row_bytes(const pixel_format::Traits & t, size_t w)
+{
+  switch (t.packing) {
+    case pixel_format::PACKED_LSB:
+      return ((w * t.bitDepth + 7) / 8);
+    case pixel_format::PACKED_GIGE:
+      return ((w + 1) / 2 * 3);
+    default:
+      break;
+  }
+  const GroupPattern g = get_group_pattern(t.layout);
+  return (
+    (w + g.numPixels - 1) / g.numPixels * strlen(g.bytes) *
+    (t.bitDepth > 8 ? 2 : 1));
+}
+
+// the inverse of unpack::unpack() and of the brightness computation
+static void encode_row(
+  const pixel_format::Traits & t, const std::vector<uint16_t> & v, uint8_t * d)
+{
+  const size_t w = v.size();
+  if (t.packing == pixel_format::PACKED_LSB) {
+    uint64_t acc = 0;
+    int numBits = 0;
+    for (size_t x = 0; x < w; x++) {
+      acc |= static_cast<uint64_t>(v[x]) << numBits;
+      for (numBits += t.bitDepth; numBits >= 8; numBits -= 8, acc >>= 8) {
+        *d++ = static_cast<uint8_t>(acc);
+      }
+    }
+    if (numBits > 0) {
+      *d = static_cast<uint8_t>(acc);
+    }
+    return;
+  }
+  if (t.packing == pixel_format::PACKED_GIGE) {
+    const int lo = t.bitDepth - 8;  // bits in the shared middle byte
+    const uint16_t mask = static_cast<uint16_t>((1 << lo) - 1);
+    for (size_t x = 0; x < w; x += 2, d += 3) {
+      const uint16_t p0 = v[x];
+      const uint16_t p1 = (x + 1 < w) ? v[x + 1] : 0;
+      d[0] = static_cast<uint8_t>(p0 >> lo);
+      d[1] = static_cast<uint8_t>((p0 & mask) | ((p1 & mask) << 4));
+      d[2] = static_cast<uint8_t>(p1 >> lo);
+    }
+    return;
+  }
+  const GroupPattern g = get_group_pattern(t.layout);
+  const bool wide = t.bitDepth > 8;
+  const uint16_t maxVal = static_cast<uint16_t>((1 << t.bitDepth) - 1);
+  const uint16_t midVal = static_cast<uint16_t>(1 << (t.bitDepth - 1));
+  for (size_t x = 0; x < w; x += g.numPixels) {
+    size_t k = x;
+    for (const char * c = g.bytes; *c; c++) {
+      uint16_t s = maxVal;
+      switch (*c) {
+        case 'G':
+          s = v[x];
+          break;
+        case 'Y':
+          s = v[std::min(k++, w - 1)];
+          break;
+        case 'C':
+          s = midVal;
+          break;
+      }
+      *d++ = static_cast<uint8_t>(s);
+      if (wide) {
+        *d++ = static_cast<uint8_t>(s >> 8);
+      }
+    }
+  }
+}
+
+// nodes can be addressed by path, but the names are unique
+static std::string bare_name(const std::string & nodeName)
+{
+  const auto pos = nodeName.rfind('/');
+  return (pos == std::string::npos ? nodeName : nodeName.substr(pos + 1));
+}
+
+struct SyntheticCamera::Buffer
+{
+  explicit Buffer(size_t size) : data(size) {}
+  std::vector<uint8_t> data;
+  std::atomic<int> refs{0};  // the stream and the consumers holding it
+};
+
+// fixed set of stream buffers, outlives the camera if the consumers
+// hold on to buffers
+struct SyntheticCamera::BufferRing
+{
+  BufferRing(size_t num, size_t size)
+  {
+    for (size_t i = 0; i < num; i++) {
+      buffers.emplace_back(new Buffer(size));
+      free.push_back(buffers.back().get());
+    }
+  }
+  // returns NULL if all buffers are in use
+  Buffer * get()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (free.empty()) {
+      return (nullptr);
+    }
+    Buffer * b = free.back();
+    free.pop_back();
+    b->refs = 1;
+    return (b);
+  }
+  void release(Buffer * b)
+  {
+    if (--(b->refs) == 0) {
+      std::unique_lock<std::mutex> lock(mutex);
+      free.push_back(b);
+    }
+  }
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  std::vector<Buffer *> free;
+};
+
+struct SyntheticCamera::BufferReleaser
+{
+  void operator()(void *)
+  {
+    ring->release(buffer);
+    (*numHeld)--;
+  }
+  std::shared_ptr<BufferRing> ring;
+  Buffer * buffer;
+  std::shared_ptr<std::atomic<int>> numHeld;
+};
+
+// shared by all cameras with the same serial number
+struct SyntheticCamera::UserSets
+{
+  std::mutex mutex;  // protects the sets, taken after the camera mutex
+  std::string defaultSet{"Default"};  // loaded at power on
+  std::unordered_map<std::string, Node> userSet1;
+};
+
+SyntheticCamera::UserSets & SyntheticCamera::getUserSets(
+  const std::string & serialNumber)
+{
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::unique_ptr<UserSets>> sets;
+  std::unique_lock<std::mutex> lock(mutex);
+  auto & us = sets[serialNumber];
+  if (!us) {
+    us.reset(new UserSets());
+  }
+  return (*us);
+}
+
+SyntheticCamera::SyntheticCamera(const Driver::SyntheticCameraConfig & config)
+: config_(config)
+{
+  if (pixel_format::from_nodemap_string(config_.pixelFormat) ==
+      pixel_format::INVALID) {
+    std::cerr << "synthetic camera: unknown pixel format "
+              << config_.pixelFormat << ", using BayerRG8" << std::endl;
+    config_.pixelFormat = "BayerRG8";
+  }
+  config_.width = std::max(config_.width, static_cast<size_t>(MIN_SIZE));
+  config_.height = std::max(config_.height, static_cast<size_t>(MIN_SIZE));
+  std::vector<std::string> formats;
+  for (int i = pixel_format::INVALID + 1; i < pixel_format::NUM_PIXEL_FORMATS;
+       i++) {
+    formats.push_back(pixel_format::to_string(static_cast<PixelFormat>(i)));
+  }
+  const std::vector<std::string> autoModes{"Off", "Once", "Continuous"};
+  const double w = static_cast<double>(config_.width);
+  const double h = static_cast<double>(config_.height);
+  addEnumNode("PixelFormat", config_.pixelFormat, formats, true);
+  addNode("Width", Driver::INT, w, MIN_SIZE, w, true);
+  addNode("Height", Driver::INT, h, MIN_SIZE, h, true);
+  addNode("OffsetX", Driver::INT, 0, 0, 0);
+  addNode("OffsetY", Driver::INT, 0, 0, 0);
+  addEnumNode(
+    "AcquisitionMode", "Continuous",
+    {"Continuous", "SingleFrame", "MultiFrame"});
+  addNode("AcquisitionFrameRateEnable", Driver::BOOL, 1, 0, 1);
+  addNode(
+    "AcquisitionFrameRate", Driver::DOUBLE, std::max(config_.frameRate, 0.0),
+    0, 1e4);
+  addEnumNode("ExposureAuto", "Off", autoModes);
+  addEnumNode("GainAuto", "Off", autoModes);
+  const double maxExposureTime =
+    config_.frameRate > 1.0 ? 1e6 / config_.frameRate : 1e6;
+  addNode(
+    "ExposureTime", Driver::DOUBLE,
+    std::min(DEFAULT_EXPOSURE_TIME, maxExposureTime), 10, maxExposureTime);
+  addNode("Gain", Driver::DOUBLE, 0, 0, 30);
+  const std::vector<std::string> userSets{"Default", "UserSet1"};
+  addEnumNode("UserSetSelector", "Default", userSets);
+  UserSets & us = getUserSets(config_.serialNumber);
+  std::unique_lock<std::mutex> lock(us.mutex);
+  if (us.defaultSet == "UserSet1" && !us.userSet1.empty()) {
+    nodes_ = us.userSet1;
+  }
+  addEnumNode("UserSetDefault", us.defaultSet, userSets);
+}
+
+SyntheticCamera::~SyntheticCamera() { stopThread(); }
+
+void SyntheticCamera::addNode(
+  const std::string & name, Driver::ParameterType type, double value,
+  double min, double max, bool locked)
+{
+  nodes_[name] = Node{type, locked, "", {}, value, min, max};
+}
+
+void SyntheticCamera::addEnumNode(
+  const std::string & name, const std::string & value,
+  const std::vector<std::string> & entries, bool locked)
+{
+  nodes_[name] = Node{Driver::ENUM, locked, value, entries, 0, 0, 0};
+}
+
+SyntheticCamera::Node * SyntheticCamera::findNode(const std::string & nodeName)
+{
+  auto it = nodes_.find(bare_name(nodeName));
+  if (!initialized_ || it == nodes_.end()) {
+    if (debug_) {
+      std::cerr << "driver: node not found: " << nodeName << std::endl;
+    }
+    return (nullptr);
+  }
+  return (&it->second);
+}
+
+// must be called with the mutex held
+void SyntheticCamera::getLimits(
+  const std::string & name, double * min, double * max)
+{
+  const Node & n = nodes_[name];
+  *min = n.min;
+  *max = n.max;
+  // the region of interest must stay on the sensor
+  const double w = static_cast<double>(config_.width);
+  const double h = static_cast<double>(config_.height);
+  if (name == "Width") {
+    *max = w - nodes_["OffsetX"].value;
+  } else if (name == "Height") {
+    *max = h - nodes_["OffsetY"].value;
+  } else if (name == "OffsetX") {
+    *max = w - nodes_["Width"].value;
+  } else if (name == "OffsetY") {
+    *max = h - nodes_["Height"].value;
+  }
+}
+
+void SyntheticCamera::init()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  initialized_ = true;
+}
+
+void SyntheticCamera::deInit()
+{
+  stopAcquisition();
+  std::unique_lock<std::mutex> lock(mutex_);
+  initialized_ = false;
+}
+
+void SyntheticCamera::startAcquisition(FrameHandler * handler)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    streaming_ = true;
+  }
+  // the stream counters start from zero, like the ones of the SDK
+  numLost_ = 0;
+  numUnderrun_ = 0;
+  numIncomplete_ = 0;
+  handler_ = handler;
+  startThread();
+}
+
+void SyntheticCamera::stopAcquisition()
+{
+  stopThread();
+  handler_ = nullptr;
+  std::unique_lock<std::mutex> lock(mutex_);
+  streaming_ = false;
+}
+
+void SyntheticCamera::restartAcquisition()
+{
+  stopThread();
+  startThread();
+}
+
+void SyntheticCamera::startThread()
+{
+  // format and size are locked while streaming
+  const Settings s = getSettings();
+  ring_ = std::make_shared<BufferRing>(
+    static_cast<size_t>(getStreamBufferCount()),
+    row_bytes(pixel_format::get_traits(s.pixelFormat), s.width) * s.height);
+  {
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    keepRunning_ = true;
+  }
+  thread_ = std::thread(&SyntheticCamera::run, this);
+}
+
+void SyntheticCamera::stopThread()
+{
+  {
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    keepRunning_ = false;
+  }
+  wakeUp_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+template <class T>
+bool SyntheticCamera::waitUntil(const T & time)
+{
+  std::unique_lock<std::mutex> lock(threadMutex_);
+  wakeUp_.wait_until(lock, time, [this] { return (!keepRunning_); });
+  return (keepRunning_);
+}
+
+int64_t SyntheticCamera::getCameraTime() const
+{
+  const double dt = chrono::duration<double, std::nano>(
+                      chrono::steady_clock::now() - powerOnTime_)
+                      .count();
+  return (static_cast<int64_t>(dt * (1.0 + config_.clockDrift * 1e-6)));
+}
+
+SyntheticCamera::Settings SyntheticCamera::getSettings()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  Settings s;
+  s.width = static_cast<size_t>(nodes_["Width"].value);
+  s.height = static_cast<size_t>(nodes_["Height"].value);
+  s.offsetX = static_cast<size_t>(nodes_["OffsetX"].value);
+  s.offsetY = static_cast<size_t>(nodes_["OffsetY"].value);
+  s.pixelFormat =
+    pixel_format::from_nodemap_string(nodes_["PixelFormat"].enumValue);
+  s.exposureTime = nodes_["ExposureTime"].value;
+  s.maxExposureTime = nodes_["ExposureTime"].max;
+  s.gain = nodes_["Gain"].value;
+  s.frameRate = nodes_["AcquisitionFrameRate"].value;
+  return (s);
+}
+
+void SyntheticCamera::run()
+{
+  if (threadConfig_.mode == Driver::POLLING_THREAD) {
+    thread_setup::apply(threadConfig_, "synthetic camera thread");
+  }
+  const Settings s0 = getSettings();
+  const pixel_format::Traits t = pixel_format::get_traits(s0.pixelFormat);
+  const size_t stride = row_bytes(t, s0.width);
+  std::vector<uint16_t> values(s0.width);
+  std::vector<uint8_t> row(stride);
+  Settings last{};
+  bool haveRow = false;
+  std::mt19937 rng(static_cast<unsigned>(numGenerated_));
+  std::uniform_real_distribution<double> jitter(
+    0, std::max(config_.deliveryJitter, 0.0));
+  auto next = chrono::steady_clock::now();
+  while (true) {
+    const Settings s = getSettings();
+    if (s.frameRate > 0) {
+      next += chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / s.frameRate));
+      next = std::max(next, chrono::steady_clock::now());  // no catching up
+    }
+    if (!waitUntil(next)) {
+      break;
+    }
+    const uint64_t n = ++numGenerated_;
+    if (config_.stallEvery != 0 && n % config_.stallEvery == 0) {
+      if (!waitUntil(
+            chrono::steady_clock::now() +
+            chrono::duration_cast<chrono::steady_clock::duration>(
+              chrono::duration<double>(config_.stallDuration)))) {
+        break;
+      }
+      next = chrono::steady_clock::now();
+    }
+    if (config_.frameIdGapEvery != 0 && n % config_.frameIdGapEvery == 0) {
+      frameId_ += config_.frameIdGapSize;
+      numLost_ += static_cast<int64_t>(config_.frameIdGapSize);
+    }
+    Buffer * buf = ring_->get();
+    if (!buf) {
+      // all buffers are held by the consumers, the frame is lost
+      numUnderrun_++;
+      frameId_++;
+      continue;
+    }
+    if (
+      !haveRow || s.exposureTime != last.exposureTime || s.gain != last.gain ||
+      s.offsetX != last.offsetX) {
+      // gradient from half to one and a half times the mean level
+      const double level = config_.sceneBrightness * s.exposureTime *
+                           std::pow(10.0, s.gain / 20.0);
+      const double scale = ((1 << t.bitDepth) - 1) / 255.0;
+      for (size_t x = 0; x < s0.width; x++) {
+        const double v = level * (0.5 + static_cast<double>(x + s.offsetX) /
+                                          config_.width);
+        values[x] = static_cast<uint16_t>(
+          std::round(std::min(std::max(v, 0.0), 255.0) * scale));
+      }
+      encode_row(t, values, row.data());
+      last = s;
+      haveRow = true;
+    }
+    for (size_t y = 0; y < s0.height; y++) {
+      memcpy(buf->data.data() + y * stride, row.data(), stride);
+    }
+    CameraFrame f;
+    f.data = buf->data.data();
+    f.imageSize = buf->data.size();
+    f.width = s0.width;
+    f.height = s0.height;
+    f.stride = stride;
+    f.offsetX = s.offsetX;
+    f.offsetY = s.offsetY;
+    f.bitsPerPixel = t.bitsPerPixel;
+    f.numChannels = t.numChannels;
+    f.frameId = frameId_++;
+    f.imageTime = getCameraTime();
+    f.exposureTime = static_cast<float>(s.exposureTime);
+    f.gain = static_cast<float>(s.gain);
+    f.maxExposureTime = static_cast<uint32_t>(s.maxExposureTime);
+    f.incomplete =
+      config_.incompleteEvery != 0 && n % config_.incompleteEvery == 0;
+    if (f.incomplete) {
+      f.status = STATUS_INCOMPLETE;
+      numIncomplete_++;
+    }
+    if (
+      config_.deliveryJitter > 0 &&
+      !waitUntil(
+        chrono::steady_clock::now() +
+        chrono::duration_cast<chrono::steady_clock::duration>(
+          chrono::duration<double>(jitter(rng))))) {
+      ring_->release(buf);
+      break;
+    }
+    f.handle = buf;
+    handler_->onFrame(f);
+    ring_->release(buf);
+  }
+}
+
+std::shared_ptr<void> SyntheticCamera::holdFrame(
+  const CameraFrame & frame, const std::shared_ptr<std::atomic<int>> & numHeld,
+  const PoolAllocator<Image> & alloc)
+{
+  Buffer * b = static_cast<Buffer *>(frame.handle);
+  b->refs++;
+  return (std::shared_ptr<void>(
+    b->data.data(), BufferReleaser{ring_, b, numHeld}, alloc));
+}
+
+std::string SyntheticCamera::getStatusDescription(int status) const
+{
+  return (status == STATUS_INCOMPLETE ? "injected incomplete frame" : "OK");
+}
+
+std::string SyntheticCamera::setEnum(
+  const std::string & nodeName, const std::string & val, std::string * retVal)
+{
+  *retVal = "UNKNOWN";
+  std::unique_lock<std::mutex> lock(mutex_);
+  Node * n = findNode(nodeName);
+  if (!n) {
+    return ("node " + nodeName + " does not exist!");
+  }
+  if (n->lockedWhileStreaming && streaming_) {
+    return ("node " + nodeName + " not available!");
+  }
+  if (n->type != Driver::ENUM) {
+    return ("node " + nodeName + " not enum???");
+  }
+  *retVal = n->enumValue;
+  if (
+    std::find(n->enumEntries.begin(), n->enumEntries.end(), val) ==
+    n->enumEntries.end()) {
+    if (debug_) {
+      std::cout << "node " << nodeName << " invalid enum: " << val << std::endl;
+      std::cout << "allowed enum values: " << std::endl;
+      for (const auto & ve : n->enumEntries) {
+        std::cout << "  " << ve << std::endl;
+      }
+    }
+    return ("node " + nodeName + " invalid enum: " + val);
+  }
+  n->enumValue = val;
+  *retVal = val;
+  if (bare_name(nodeName) == "UserSetDefault") {
+    UserSets & us = getUserSets(config_.serialNumber);
+    std::unique_lock<std::mutex> usLock(us.mutex);
+    us.defaultSet = val;
+  }
+  return ("OK");
+}
+
+std::string SyntheticCamera::setNumber(
+  const std::string & nodeName, Driver::ParameterType type, double val,
+  double * retVal)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  Node * n = findNode(nodeName);
+  if (!n) {
+    return ("node " + nodeName + " does not exist!");
+  }
+  if (n->lockedWhileStreaming && streaming_) {
+    return ("node " + nodeName + " not available!");
+  }
+  if (n->type != type) {
+    return ("node " + nodeName + " has wrong type!");
+  }
+  double min, max;
+  getLimits(bare_name(nodeName), &min, &max);
+  *retVal = n->value;
+  if (val < min || val > max) {
+    return ("node " + nodeName + " value out of range!");
+  }
+  n->value = (type == Driver::DOUBLE) ? val : std::round(val);
+  *retVal = n->value;
+  return ("OK");
+}
+
+std::string SyntheticCamera::setDouble(
+  const std::string & nodeName, double val, double * retVal)
+{
+  *retVal = std::nan("");
+  return (setNumber(nodeName, Driver::DOUBLE, val, retVal));
+}
+
+std::string SyntheticCamera::setInt(
+  const std::string & nodeName, int val, int * retVal)
+{
+  double r = -1;
+  const std::string msg = setNumber(nodeName, Driver::INT, val, &r);
+  *retVal = static_cast<int>(r);
+  return (msg);
+}
+
+std::string SyntheticCamera::setBool(
+  const std::string & nodeName, bool val, bool * retVal)
+{
+  double r = val ? 0 : 1;
+  const std::string msg = setNumber(nodeName, Driver::BOOL, val, &r);
+  *retVal = (r != 0);
+  return (msg);
+}
+
+bool SyntheticCamera::getEnum(const std::string & nodeName, std::string * val)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  if (!n || n->type != Driver::ENUM) {
+    return (false);
+  }
+  *val = n->enumValue;
+  return (true);
+}
+
+bool SyntheticCamera::getDouble(const std::string & nodeName, double * val)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  if (!n || n->type != Driver::DOUBLE) {
+    return (false);
+  }
+  *val = n->value;
+  return (true);
+}
+
+bool SyntheticCamera::getInt(const std::string & nodeName, int64_t * val)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  if (!n || n->type != Driver::INT) {
+    return (false);
+  }
+  *val = static_cast<int64_t>(n->value);
+  return (true);
+}
+
+bool SyntheticCamera::getBool(const std::string & nodeName, bool * val)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  if (!n || n->type != Driver::BOOL) {
+    return (false);
+  }
+  *val = (n->value != 0);
+  return (true);
+}
+
+bool SyntheticCamera::getString(const std::string & nodeName, std::string * val)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!initialized_) {
+    return (false);
+  }
+  const std::string name = bare_name(nodeName);
+  if (name == "DeviceSerialNumber") {
+    *val = config_.serialNumber;
+  } else if (name == "DeviceFirmwareVersion") {
+    *val = FIRMWARE_VERSION;
+  } else {
+    return (false);
+  }
+  return (true);
+}
+
+bool SyntheticCamera::getIntLimits(
+  const std::string & nodeName, int64_t * min, int64_t * max, int64_t * inc)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  if (!n || n->type != Driver::INT) {
+    return (false);
+  }
+  double lo, hi;
+  getLimits(bare_name(nodeName), &lo, &hi);
+  *min = static_cast<int64_t>(lo);
+  *max = static_cast<int64_t>(hi);
+  *inc = 1;
+  return (true);
+}
+
+bool SyntheticCamera::execute(const std::string & nodeName)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const std::string name = bare_name(nodeName);
+  if (!initialized_ || streaming_) {
+    return (false);
+  }
+  if (nodes_["UserSetSelector"].enumValue != "UserSet1") {
+    return (false);  // the default set is read only
+  }
+  UserSets & us = getUserSets(config_.serialNumber);
+  std::unique_lock<std::mutex> usLock(us.mutex);
+  if (name == "UserSetSave") {
+    us.userSet1 = nodes_;
+  } else if (name == "UserSetLoad" && !us.userSet1.empty()) {
+    const Node defaultSet = nodes_["UserSetDefault"];
+    nodes_ = us.userSet1;
+    nodes_["UserSetDefault"] = defaultSet;
+  } else {
+    return (false);
+  }
+  return (true);
+}
+
+bool SyntheticCamera::isLocked(const std::string & nodeName)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Node * n = findNode(nodeName);
+  return (n && n->lockedWhileStreaming && streaming_);
+}
+
+bool SyntheticCamera::setExposure(double exposureTime, double gain)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!initialized_) {
+    return (false);
+  }
+  Node & et = nodes_["ExposureTime"];
+  Node & g = nodes_["Gain"];
+  et.value = std::min(std::max(exposureTime, et.min), et.max);
+  g.value = std::min(std::max(gain, g.min), g.max);
+  return (true);
+}
+
+std::string SyntheticCamera::getNodeMapAsString()
+{
+  static const char * const typeNames[] = {
+    "Enumeration", "Float", "Integer", "Boolean"};
+  std::unique_lock<std::mutex> lock(mutex_);
+  const std::map<std::string, Node> sorted(nodes_.begin(), nodes_.end());
+  std::stringstream ss;
+  ss << "<SyntheticCamera SerialNumber=\"" << config_.serialNumber << "\">"
+     << std::endl;
+  for (const auto & kv : sorted) {
+    const Node & n = kv.second;
+    ss << "  <" << typeNames[n.type] << " Name=\"" << kv.first << "\">";
+    if (n.type == Driver::ENUM) {
+      ss << "<Value>" << n.enumValue << "</Value>";
+      for (const auto & e : n.enumEntries) {
+        ss << "<EnumEntry Name=\"" << e << "\"/>";
+      }
+    } else {
+      double min, max;
+      getLimits(kv.first, &min, &max);
+      ss << "<Value>" << n.value << "</Value><Min>" << min << "</Min><Max>"
+         << max << "</Max>";
+    }
+    ss << "</" << typeNames[n.type] << ">" << std::endl;
+  }
+  ss << "</SyntheticCamera>" << std::endl;
+  return (ss.str());
+}
+
+int64_t SyntheticCamera::getStreamBufferCount()
+{
+  return (streamBufferCount_ > 0 ? streamBufferCount_
+                                 : getDefaultStreamBufferCount());
+}
+
+int64_t SyntheticCamera::getDefaultStreamBufferCount()
+{
+  return (std::max(config_.numStreamBuffers, 1));
+}
+
+bool SyntheticCamera::setStreamBufferCount(int64_t count)
+{
+  // applied at the next start
+  streamBufferCount_ = std::min(std::max(count, int64_t(1)), MAX_BUFFERS);
+  if (debug_) {
+    std::cout << "stream buffer count set to " << streamBufferCount_
+              << std::endl;
+  }
+  return (true);
+}
+
+bool SyntheticCamera::setStreamBufferHandling(const std::string & mode)
+{
+  // Frames are handed over as soon as they are generated, so there is
+  // never more than one to choose from, and the mode makes no difference.
+  if (
+    mode != "OldestFirst" && mode != "OldestFirstOverwrite" &&
+    mode != "NewestOnly" && mode != "NewestFirst") {
+    return (false);
+  }
+  if (debug_) {
+    std::cout << "stream buffer handling set to " << mode << std::endl;
+  }
+  return (true);
+}
+
+void SyntheticCamera::getStreamStatistics(Driver::FrameDropStatistics * s)
+{
+  s->streamLostFrameCount = numLost_;
+  s->streamDroppedFrameCount = numUnderrun_;
+  s->streamBufferUnderrunCount = numUnderrun_;
+  s->streamIncompleteFrameCount = numIncomplete_;
+  s->streamResendRequestCount = -1;  // there is no transport layer
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,165 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SYNTHETIC_CAMERA_H_
+#define SYNTHETIC_CAMERA_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "camera.h"
+
+namespace flir_spinnaker_common
+{
+//
+// Camera that generates its frames in software, on its own thread.
+// The nodes live in an in-memory map with the usual names (Width,
+// PixelFormat, ExposureTime, ...), and the stream has a fixed set of
+// buffers that can be held by the consumers just like SDK buffers.
+// Incomplete frames, frame id gaps and stalls can be injected to
+// exercise the error paths of the driver.
+//
+class SyntheticCamera : public Camera
+{
+public:
+  explicit SyntheticCamera(const Driver::SyntheticCameraConfig & config);
+  ~SyntheticCamera();
+
+  void init() override;
+  void deInit() override;
+  void startAcquisition(FrameHandler * handler) override;
+  void stopAcquisition() override;
+  void restartAcquisition() override;
+  std::shared_ptr<void> holdFrame(
+    const CameraFrame & frame,
+    const std::shared_ptr<std::atomic<int>> & numHeld,
+    const PoolAllocator<Image> & alloc) override;
+  std::string getStatusDescription(int status) const override;
+
+  std::string setEnum(
+    const std::string & nodeName, const std::string & val,
+    std::string * retVal) override;
+  std::string setDouble(
+    const std::string & nodeName, double val, double * retVal) override;
+  std::string setInt(
+    const std::string & nodeName, int val, int * retVal) override;
+  std::string setBool(
+    const std::string & nodeName, bool val, bool * retVal) override;
+  bool getEnum(const std::string & nodeName, std::string * val) override;
+  bool getDouble(const std::string & nodeName, double * val) override;
+  bool getInt(const std::string & nodeName, int64_t * val) override;
+  bool getBool(const std::string & nodeName, bool * val) override;
+  bool getString(const std::string & nodeName, std::string * val) override;
+  bool getIntLimits(
+    const std::string & nodeName, int64_t * min, int64_t * max,
+    int64_t * inc) override;
+  bool execute(const std::string & nodeName) override;
+  bool isLocked(const std::string & nodeName) override;
+  bool setExposure(double exposureTime, double gain) override;
+  std::string getNodeMapAsString() override;
+
+  int64_t getStreamBufferCount() override;
+  int64_t getDefaultStreamBufferCount() override;
+  bool setStreamBufferCount(int64_t count) override;
+  bool setStreamBufferHandling(const std::string & mode) override;
+  void getStreamStatistics(Driver::FrameDropStatistics * s) override;
+
+private:
+  struct Buffer;
+  struct BufferRing;
+  struct BufferReleaser;
+  struct Node
+  {
+    Driver::ParameterType type;
+    bool lockedWhileStreaming;
+    std::string enumValue;
+    std::vector<std::string> enumEntries;
+    double value;  // for DOUBLE, INT and BOOL
+    double min;
+    double max;
+  };
+  // what a frame is generated from
+  struct Settings
+  {
+    size_t width;
+    size_t height;
+    size_t offsetX;
+    size_t offsetY;
+    pixel_format::PixelFormat pixelFormat;
+    double exposureTime;
+    double maxExposureTime;
+    double gain;
+    double frameRate;
+  };
+  void addNode(
+    const std::string & name, Driver::ParameterType type, double value,
+    double min, double max, bool locked = false);
+  void addEnumNode(
+    const std::string & name, const std::string & value,
+    const std::vector<std::string> & entries, bool locked = false);
+  Node * findNode(const std::string & nodeName);
+  // the limits of some nodes depend on other nodes
+  void getLimits(const std::string & name, double * min, double * max);
+  std::string setNumber(
+    const std::string & nodeName, Driver::ParameterType type, double val,
+    double * retVal);
+  Settings getSettings();
+  void startThread();
+  void stopThread();
+  void run();
+  // false if stopped while waiting
+  template <class T>
+  bool waitUntil(const T & time);
+  int64_t getCameraTime() const;
+  // user sets survive the camera object, like the flash of a camera
+  struct UserSets;
+  static UserSets & getUserSets(const std::string & serialNumber);
+
+  // ----- variables --
+  Driver::SyntheticCameraConfig config_;
+  std::mutex mutex_;  // protects the nodes
+  std::unordered_map<std::string, Node> nodes_;
+  bool initialized_{false};
+  bool streaming_{false};
+  int64_t streamBufferCount_{0};  // 0: the default
+  FrameHandler * handler_{nullptr};
+  std::shared_ptr<BufferRing> ring_;
+  uint64_t frameId_{0};
+  uint64_t numGenerated_{0};
+  // the camera clock starts at power on
+  std::chrono::steady_clock::time_point powerOnTime_{
+    std::chrono::steady_clock::now()};
+  std::atomic<int64_t> numLost_{0};
+  std::atomic<int64_t> numUnderrun_{0};
+  std::atomic<int64_t> numIncomplete_{0};
+  std::mutex threadMutex_;  // only used for sleeping
+  std::condition_variable wakeUp_;
+  bool keepRunning_{false};
+  std::thread thread_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // SYNTHETIC_CAMERA_H_
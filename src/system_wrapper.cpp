@@ -0,0 +1,194 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "system_wrapper.h"
+
+#include <SpinGenApi/SpinnakerGenApi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace flir_spinnaker_common
+{
+namespace GenApi = Spinnaker::GenApi;
+
+static std::string get_serial(Spinnaker::CameraPtr cam)
+{
+  const auto & nodeMap = cam->GetTLDeviceNodeMap();
+  const GenApi::CStringPtr psn = nodeMap.GetNode("DeviceSerialNumber");
+  return (
+    psn.IsValid() && GenApi::IsAvailable(psn) && GenApi::IsReadable(psn)
+      ? std::string(psn->GetValue())
+      : "");
+}
+
+// Runs on an SDK thread, which must not be blocked by the driver,
+// so the events are passed on to the wrapper's own thread.
+class SystemWrapper::DeviceEventHandler
+: public Spinnaker::InterfaceEventHandler
+{
+public:
+  explicit DeviceEventHandler(SystemWrapper * w) : wrapper_(w) {}
+  void OnDeviceArrival(uint64_t serial) override { post(serial, true); }
+  void OnDeviceRemoval(uint64_t serial) override { post(serial, false); }
+
+private:
+  void post(uint64_t serial, bool arrived)
+  {
+    SystemWrapper * w = wrapper_;
+    const std::string sn = std::to_string(serial);
+    w->eventThread_->post(
+      [w, sn, arrived]() { w->handleDeviceEvent(sn, arrived); });
+  }
+  SystemWrapper * wrapper_;
+};
+
+std::shared_ptr<SystemWrapper> SystemWrapper::getInstance()
+{
+  static std::mutex mutex;
+  static std::weak_ptr<SystemWrapper> instance;
+  std::unique_lock<std::mutex> lock(mutex);
+  std::shared_ptr<SystemWrapper> sys = instance.lock();
+  if (!sys) {
+    sys.reset(new SystemWrapper());
+    instance = sys;
+  }
+  return (sys);
+}
+
+SystemWrapper::SystemWrapper()
+{
+  system_ = Spinnaker::System::GetInstance();
+  if (!system_) {
+    std::cerr << "cannot instantiate spinnaker driver!" << std::endl;
+    throw std::runtime_error("failed to get spinnaker driver!");
+  }
+  eventThread_.reset(new ThreadPool(1));
+  deviceEventHandler_.reset(new DeviceEventHandler(this));
+  system_->RegisterInterfaceEventHandler(*deviceEventHandler_);
+}
+
+SystemWrapper::~SystemWrapper()
+{
+  system_->UnregisterInterfaceEventHandler(*deviceEventHandler_);
+  eventThread_.reset();  // finishes the pending events
+  serialToCamera_.clear();
+  cameraList_.Clear();
+  if (system_) {
+    system_->ReleaseInstance();
+  }
+}
+
+std::string SystemWrapper::getLibraryVersion() const
+{
+  const Spinnaker::LibraryVersion lv = system_->GetLibraryVersion();
+  char buf[256];
+  snprintf(
+    buf, sizeof(buf), "%d.%d.%d.%d", lv.major, lv.minor, lv.type, lv.build);
+  return std::string(buf);
+}
+
+void SystemWrapper::refreshCameraList()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cameraList_ = system_->GetCameras();
+  serialToCamera_.clear();
+  serials_.clear();
+  for (size_t cam_idx = 0; cam_idx < cameraList_.GetSize(); cam_idx++) {
+    auto cam = cameraList_.GetByIndex(cam_idx);
+    const std::string sn = get_serial(cam);
+    serials_.push_back(sn);
+    serialToCamera_[sn] = cam;
+  }
+  hasCameraList_ = true;
+}
+
+std::vector<std::string> SystemWrapper::getSerialNumbers() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return (serials_);
+}
+
+Spinnaker::CameraPtr SystemWrapper::findCamera(const std::string & serial) const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = serialToCamera_.find(serial);
+  return (it == serialToCamera_.end() ? Spinnaker::CameraPtr() : it->second);
+}
+
+void SystemWrapper::handleDeviceEvent(const std::string & serial, bool arrived)
+{
+  {
+    // update the list without enumerating all cameras again
+    std::unique_lock<std::mutex> lock(mutex_);
+    serialToCamera_.erase(serial);
+    serials_.erase(
+      std::remove(serials_.begin(), serials_.end(), serial), serials_.end());
+    if (arrived) {
+      // the SDK has updated its list before raising the event
+      Spinnaker::CameraPtr cam =
+        system_->GetCameras(false, false).GetBySerial(serial);
+      if (cam) {
+        serialToCamera_[serial] = cam;
+        serials_.push_back(serial);
+      }
+    } else {
+      cameraList_.RemoveBySerial(serial);
+    }
+  }
+  std::unique_lock<std::mutex> lock(callbackMutex_);
+  // not called under the lock, so they can add and remove callbacks
+  const std::map<int, DeviceCallback> callbacks(deviceCallbacks_);
+  callbackThread_ = std::this_thread::get_id();
+  for (const auto & cb : callbacks) {
+    if (deviceCallbacks_.count(cb.first) == 0) {
+      continue;  // removed meanwhile
+    }
+    runningCallback_ = cb.first;
+    lock.unlock();
+    try {
+      cb.second(serial, arrived);
+    } catch (const std::exception & e) {
+      std::cerr << "device event handling failed: " << e.what() << std::endl;
+    }
+    lock.lock();
+    runningCallback_ = -1;
+    callbackDone_.notify_all();
+  }
+}
+
+int SystemWrapper::addDeviceCallback(const DeviceCallback & cb)
+{
+  std::unique_lock<std::mutex> lock(callbackMutex_);
+  deviceCallbacks_[nextCallbackId_] = cb;
+  return (nextCallbackId_++);
+}
+
+void SystemWrapper::removeDeviceCallback(int id)
+{
+  std::unique_lock<std::mutex> lock(callbackMutex_);
+  deviceCallbacks_.erase(id);
+  callbackDone_.wait(lock, [this, id]() {
+    return (
+      runningCallback_ != id ||
+      std::this_thread::get_id() == callbackThread_);
+  });
+}
+}  // namespace flir_spinnaker_common
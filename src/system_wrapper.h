@@ -0,0 +1,87 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYSTEM_WRAPPER_H_
+#define SYSTEM_WRAPPER_H_
+
+#include <Spinnaker.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+//
+// Owns the Spinnaker System instance and the camera list. All drivers
+// in a process share one instance, so the cameras are enumerated once
+// rather than once per driver.
+//
+class ThreadPool;
+class SystemWrapper
+{
+public:
+  // called when a camera is plugged in (arrived) or removed
+  typedef std::function<void(const std::string & serial, bool arrived)>
+    DeviceCallback;
+  ~SystemWrapper();
+  static std::shared_ptr<SystemWrapper> getInstance();
+
+  std::string getLibraryVersion() const;
+  // enumerates the cameras and reads their serial numbers
+  void refreshCameraList();
+  bool hasCameraList() const
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return (hasCameraList_);
+  }
+  std::vector<std::string> getSerialNumbers() const;
+  // returns an invalid pointer if serial number is unknown
+  Spinnaker::CameraPtr findCamera(const std::string & serial) const;
+  // The camera list follows the arrival and removal of cameras, and
+  // the callbacks run on a thread of the wrapper, one event at a time.
+  // Once removeDeviceCallback() returns, the callback is not running
+  // and will not be called again (unless removed by itself).
+  int addDeviceCallback(const DeviceCallback & cb);
+  void removeDeviceCallback(int id);
+
+private:
+  class DeviceEventHandler;
+  SystemWrapper();
+  void handleDeviceEvent(const std::string & serial, bool arrived);
+  // ----- variables --
+  Spinnaker::SystemPtr system_;
+  Spinnaker::CameraList cameraList_;
+  std::map<std::string, Spinnaker::CameraPtr> serialToCamera_;
+  std::vector<std::string> serials_;  // in camera list order
+  bool hasCameraList_{false};
+  mutable std::mutex mutex_;
+  std::unique_ptr<DeviceEventHandler> deviceEventHandler_;
+  std::unique_ptr<ThreadPool> eventThread_;
+  std::mutex callbackMutex_;
+  std::condition_variable callbackDone_;
+  std::map<int, DeviceCallback> deviceCallbacks_;
+  int nextCallbackId_{0};
+  int runningCallback_{-1};
+  std::thread::id callbackThread_;
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // SYSTEM_WRAPPER_H_
@@ -0,0 +1,122 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace flir_spinnaker_common
+{
+ThreadPool::ThreadPool(int numThreads)
+{
+  for (int i = 0; i < numThreads; i++) {
+    threads_.emplace_back(&ThreadPool::run, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+    cv_.notify_all();
+  }
+  for (auto & th : threads_) {
+    th.join();
+  }
+}
+
+ThreadPool & ThreadPool::getProcessingPool()
+{
+  // the calling thread does part of the work, so one less is enough
+  static ThreadPool pool(
+    std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0));
+  return (pool);
+}
+
+void ThreadPool::post(const std::function<void()> & task)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  tasks_.push_back(task);
+  cv_.notify_one();
+}
+
+void ThreadPool::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return (!tasks_.empty() || !keepRunning_); });
+    if (tasks_.empty()) {
+      return;  // shutting down and no work left
+    }
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+void ThreadPool::parallelFor(
+  size_t n, size_t minChunk, int maxTasks,
+  const std::function<void(size_t, size_t)> & f)
+{
+  const size_t maxByWork =
+    std::max(n / std::max(minChunk, size_t(1)), size_t(1));
+  const size_t maxByThreads =
+    static_cast<size_t>(maxTasks > 0 ? maxTasks : getNumThreads() + 1);
+  const size_t numTasks =
+    std::min(std::min(maxByWork, maxByThreads), threads_.size() + 1);
+  if (numTasks <= 1) {
+    f(0, n);
+    return;
+  }
+  const size_t chunk = (n + numTasks - 1) / numTasks;
+  // the tasks refer to these, so all of them must finish before return
+  std::mutex doneMutex;
+  std::condition_variable doneCv;
+  size_t numDone = 0;
+  std::exception_ptr error;  // the first one thrown
+  auto runRange = [&](size_t begin, size_t end) {
+    try {
+      if (begin < end) {
+        f(begin, end);
+      }
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(doneMutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+  for (size_t t = 1; t < numTasks; t++) {
+    const size_t begin = t * chunk;
+    const size_t end = std::min(begin + chunk, n);
+    post([&, begin, end]() {
+      runRange(begin, end);
+      std::unique_lock<std::mutex> lock(doneMutex);
+      numDone++;
+      doneCv.notify_one();
+    });
+  }
+  runRange(0, std::min(chunk, n));
+  std::unique_lock<std::mutex> lock(doneMutex);
+  doneCv.wait(lock, [&] { return (numDone == numTasks - 1); });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,61 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+//
+// Fixed set of worker threads executing tasks in FIFO order.
+//
+class ThreadPool
+{
+public:
+  explicit ThreadPool(int numThreads);
+  ~ThreadPool();
+  int getNumThreads() const { return (static_cast<int>(threads_.size())); }
+  void post(const std::function<void()> & task);
+  // Splits [0, n) into at most maxTasks ranges of at least minChunk
+  // elements and calls f(begin, end) for each of them. The calling
+  // thread works on one of the ranges. Returns when all are done, and
+  // then rethrows the first exception thrown by f, if any. Calling it
+  // from a task of the same pool can deadlock, since the ranges wait
+  // for workers that may all be blocked the same way.
+  void parallelFor(
+    size_t n, size_t minChunk, int maxTasks,
+    const std::function<void(size_t, size_t)> & f);
+  // pool shared by the image processing functions, one thread per core
+  static ThreadPool & getProcessingPool();
+
+private:
+  void run();
+  // ----- variables --
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool keepRunning_{true};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // THREAD_POOL_H_
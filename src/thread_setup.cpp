@@ -0,0 +1,116 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "thread_setup.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace flir_spinnaker_common
+{
+namespace thread_setup
+{
+#ifdef __linux__
+bool set_affinity(const std::vector<int> & cpus, std::string * msg)
+{
+  if (cpus.empty()) {
+    return (true);
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const int c : cpus) {
+    if (c < 0 || c >= CPU_SETSIZE) {
+      *msg = "invalid cpu " + std::to_string(c);
+      return (false);
+    }
+    CPU_SET(c, &set);
+  }
+  const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (rc != 0) {
+    *msg = std::string("cannot set cpu affinity: ") + strerror(rc);
+    return (false);
+  }
+  return (true);
+}
+
+bool set_realtime_priority(int priority, std::string * msg)
+{
+  if (priority <= 0) {
+    return (true);
+  }
+  sched_param p;
+  memset(&p, 0, sizeof(p));
+  p.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+  const int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &p);
+  if (rc != 0) {
+    *msg = std::string("cannot set SCHED_FIFO priority: ") + strerror(rc);
+    return (false);
+  }
+  return (true);
+}
+
+bool lock_memory(std::string * msg)
+{
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    *msg = std::string("cannot lock memory: ") + strerror(errno);
+    return (false);
+  }
+  return (true);
+}
+#else
+bool set_affinity(const std::vector<int> & cpus, std::string * msg)
+{
+  *msg = "cpu affinity not supported on this platform";
+  return (cpus.empty());
+}
+
+bool set_realtime_priority(int priority, std::string * msg)
+{
+  *msg = "real time priority not supported on this platform";
+  return (priority <= 0);
+}
+
+bool lock_memory(std::string * msg)
+{
+  *msg = "memory locking not supported on this platform";
+  return (false);
+}
+#endif
+
+void apply(
+  const Driver::AcquisitionThreadConfig & c, const std::string & name)
+{
+  std::string msg;
+  if (!set_affinity(c.cpus, &msg)) {
+    std::cerr << "WARNING: " << name << ": " << msg << std::endl;
+  }
+  if (!set_realtime_priority(c.priority, &msg)) {
+    std::cerr << "WARNING: " << name << ": " << msg << std::endl;
+  }
+  if (c.lockMemory && !lock_memory(&msg)) {
+    std::cerr << "WARNING: " << name << ": " << msg << std::endl;
+  }
+}
+}  // namespace thread_setup
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,43 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THREAD_SETUP_H_
+#define THREAD_SETUP_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <string>
+#include <vector>
+
+namespace flir_spinnaker_common
+{
+namespace thread_setup
+{
+// Pins the calling thread to the given CPUs (empty: leave alone).
+// Returns false and sets msg on failure.
+bool set_affinity(const std::vector<int> & cpus, std::string * msg);
+// SCHED_FIFO at the given priority (1..99) for the calling thread,
+// 0 leaves the scheduling alone. Usually needs CAP_SYS_NICE.
+bool set_realtime_priority(int priority, std::string * msg);
+// locks current and future pages of the process into memory
+bool lock_memory(std::string * msg);
+// applies all of the above, printing a warning for anything that fails
+void apply(
+  const Driver::AcquisitionThreadConfig & c, const std::string & name);
+}  // namespace thread_setup
+}  // namespace flir_spinnaker_common
+
+#endif  // THREAD_SETUP_H_
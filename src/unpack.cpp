@@ -0,0 +1,308 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/unpack.h>
+
+#include "buffer_pool.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UNPACK_HAS_X86
+#endif
+
+namespace flir_spinnaker_common
+{
+namespace unpack
+{
+using pixel_format::PixelFormat;
+
+// don't bother other threads with less rows than this
+static const size_t MIN_ROWS_PER_TASK = 32;
+
+enum Layout {
+  NONE,
+  P10,  // 4 pixels in 5 bytes, LSB first
+  P12,  // 2 pixels in 3 bytes, LSB first
+  G10,  // GigE Vision "Packed", 2 pixels in 3 bytes
+  G12
+};
+
+static constexpr Layout get_layout(const pixel_format::Traits & t)
+{
+  return (
+    t.packing == pixel_format::PACKED_LSB
+      ? (t.bitDepth == 10 ? P10 : P12)
+      : (t.packing == pixel_format::PACKED_GIGE ? (t.bitDepth == 10 ? G10 : G12)
+                                                : NONE));
+}
+
+static size_t row_bytes(Layout l, size_t w)
+{
+  return (l == P10 ? (w * 10 + 7) / 8 : (w * 12 + 7) / 8);
+}
+
+// unpacks pixels [start, w) of a row
+template <Layout l>
+static void unpack_row_scalar(
+  const uint8_t * s, size_t start, size_t w, uint16_t * d)
+{
+  switch (l) {
+    case P10:
+    case P12: {
+      const size_t bits = (l == P10) ? 10 : 12;
+      const uint32_t mask = (1u << bits) - 1;
+      for (size_t j = start; j < w; j++) {
+        const size_t bit = j * bits;
+        const uint8_t * b = s + (bit >> 3);
+        const uint32_t v = b[0] | (b[1] << 8);
+        d[j] = static_cast<uint16_t>((v >> (bit & 7)) & mask);
+      }
+      break;
+    }
+    case G10:
+      for (size_t j = start; j < w; j++) {
+        const uint8_t * b = s + (j / 2) * 3;
+        d[j] = static_cast<uint16_t>(
+          (j & 1) ? ((b[2] << 2) | ((b[1] >> 4) & 0x03))
+                  : ((b[0] << 2) | (b[1] & 0x03)));
+      }
+      break;
+    case G12:
+      for (size_t j = start; j < w; j++) {
+        const uint8_t * b = s + (j / 2) * 3;
+        d[j] = static_cast<uint16_t>(
+          (j & 1) ? ((b[2] << 4) | (b[1] >> 4))
+                  : ((b[0] << 4) | (b[1] & 0x0F)));
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+typedef void (*RowFunction)(
+  const uint8_t * s, size_t w, size_t rowBytes, uint16_t * d);
+
+template <Layout l>
+static void unpack_row_plain(const uint8_t * s, size_t w, size_t, uint16_t * d)
+{
+  unpack_row_scalar<l>(s, 0, w, d);
+}
+
+#ifdef UNPACK_HAS_X86
+//
+// Every iteration unpacks 8 pixels from one 16 byte load. A shuffle
+// moves the two bytes holding each pixel into a 16 bit lane, then
+// shifts and masks extract the value.
+//
+template <Layout l>
+__attribute__((target("ssse3"))) static void unpack_row_ssse3(
+  const uint8_t * s, size_t w, size_t rowBytes, uint16_t * d)
+{
+  const size_t inBytes = (l == P10) ? 10 : 12;  // per 8 pixels
+  size_t j = 0;
+  size_t off = 0;
+  switch (l) {
+    case P10: {
+      const __m128i shuf =
+        _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+      // shift left to drop the bits above, then right by 6
+      const __m128i mul = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+      for (; off + 16 <= rowBytes && j + 8 <= w; j += 8, off += inBytes) {
+        const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + off));
+        const __m128i x = _mm_shuffle_epi8(v, shuf);
+        _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(d + j),
+          _mm_srli_epi16(_mm_mullo_epi16(x, mul), 6));
+      }
+      break;
+    }
+    case P12: {
+      const __m128i shuf =
+        _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+      const __m128i even = _mm_set1_epi32(0x0000FFFF);
+      const __m128i lowMask = _mm_set1_epi16(0x0FFF);
+      for (; off + 16 <= rowBytes && j + 8 <= w; j += 8, off += inBytes) {
+        const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + off));
+        const __m128i x = _mm_shuffle_epi8(v, shuf);
+        const __m128i e = _mm_and_si128(_mm_and_si128(x, lowMask), even);
+        const __m128i o = _mm_andnot_si128(even, _mm_srli_epi16(x, 4));
+        _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(d + j), _mm_or_si128(e, o));
+      }
+      break;
+    }
+    case G10:
+    case G12: {
+      // even pixels: hi = byte 0, lo = byte 1; odd: hi = byte 2, lo = byte 1
+      const __m128i shuf =
+        _mm_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+      const __m128i even = _mm_set1_epi32(0x0000FFFF);
+      for (; off + 16 <= rowBytes && j + 8 <= w; j += 8, off += inBytes) {
+        const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + off));
+        const __m128i x = _mm_shuffle_epi8(v, shuf);
+        __m128i r;
+        if (l == G12) {
+          // even: (x >> 4) & 0xFF0 | x & 0xF, odd: x >> 4
+          const __m128i hi = _mm_srli_epi16(x, 4);
+          const __m128i e = _mm_or_si128(
+            _mm_and_si128(hi, _mm_set1_epi16(0x0FF0)),
+            _mm_and_si128(x, _mm_set1_epi16(0x000F)));
+          r = _mm_or_si128(
+            _mm_and_si128(e, even), _mm_andnot_si128(even, hi));
+        } else {
+          // (x >> 6) & 0x3FC | low bits (even: x & 3, odd: (x >> 4) & 3)
+          const __m128i hi =
+            _mm_and_si128(_mm_srli_epi16(x, 6), _mm_set1_epi16(0x03FC));
+          const __m128i lo = _mm_or_si128(
+            _mm_and_si128(x, even),
+            _mm_andnot_si128(even, _mm_srli_epi16(x, 4)));
+          r = _mm_or_si128(hi, _mm_and_si128(lo, _mm_set1_epi16(0x0003)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d + j), r);
+      }
+      break;
+    }
+    default:
+      return;
+  }
+  unpack_row_scalar<l>(s, j, w, d);  // leftover pixels
+}
+#endif
+
+// one row function per layout
+struct Kernels
+{
+  RowFunction rows[G12 + 1];
+  const char * name;
+};
+
+static const Kernels scalar_kernels{
+  {nullptr, unpack_row_plain<P10>, unpack_row_plain<P12>,
+   unpack_row_plain<G10>, unpack_row_plain<G12>},
+  "scalar"};
+#ifdef UNPACK_HAS_X86
+static const Kernels ssse3_kernels{
+  {nullptr, unpack_row_ssse3<P10>, unpack_row_ssse3<P12>,
+   unpack_row_ssse3<G10>, unpack_row_ssse3<G12>},
+  "ssse3"};
+#endif
+
+// null if the CPU does not support the instruction set
+static const Kernels * find_kernels(const char * name)
+{
+#ifdef UNPACK_HAS_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "ssse3") && __builtin_cpu_supports("ssse3")) {
+    return (&ssse3_kernels);
+  }
+#endif
+  return (!strcmp(name, "scalar") ? &scalar_kernels : nullptr);
+}
+
+static const Kernels * select_kernels()
+{
+  const Kernels * k = find_kernels("ssse3");
+  return (k ? k : &scalar_kernels);
+}
+
+static std::atomic<const Kernels *> & current_kernels()
+{
+  static std::atomic<const Kernels *> kernels{select_kernels()};
+  return (kernels);
+}
+
+// instantiated per pixel format by pixel_format::dispatch()
+template <PixelFormat F>
+struct UnpackKernel
+{
+  static bool run(
+    const uint8_t * src, size_t w, size_t h, size_t srcStride, uint16_t * dst,
+    size_t dstStride, int numThreads)
+  {
+    constexpr Layout l = get_layout(pixel_format::get_traits(F));
+    if (l == NONE || !src || !dst) {
+      return (false);
+    }
+    const RowFunction f =
+      current_kernels().load(std::memory_order_relaxed)->rows[l];
+    const size_t rb = row_bytes(l, w);
+    ThreadPool::getProcessingPool().parallelFor(
+      h, MIN_ROWS_PER_TASK, numThreads, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          f(src + row * srcStride, w, rb,
+            reinterpret_cast<uint16_t *>(
+              reinterpret_cast<uint8_t *>(dst) + row * dstStride));
+        }
+      });
+    return (true);
+  }
+};
+
+bool is_packed(PixelFormat pf)
+{
+  return (get_layout(pixel_format::get_traits(pf)) != NONE);
+}
+
+bool unpack(
+  PixelFormat pf, const uint8_t * src, size_t w, size_t h, size_t srcStride,
+  uint16_t * dst, size_t dstStride, int numThreads)
+{
+  return (pixel_format::dispatch<UnpackKernel>(
+    pf, src, w, h, srcStride, dst, dstStride, numThreads));
+}
+
+bool unpack(const Image & img, uint16_t * dst, size_t dstStride, int numThreads)
+{
+  return (unpack(
+    img.pixelFormat_, static_cast<const uint8_t *>(img.data_), img.width_,
+    img.height_, img.stride_, dst, dstStride, numThreads));
+}
+
+std::shared_ptr<uint16_t> unpack(const Image & img, int numThreads)
+{
+  static std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>(4);
+  if (!is_packed(img.pixelFormat_)) {
+    return (std::shared_ptr<uint16_t>());
+  }
+  const size_t dstStride = img.width_ * sizeof(uint16_t);
+  std::shared_ptr<uint8_t> buf = pool->get(dstStride * img.height_);
+  std::shared_ptr<uint16_t> dst(buf, reinterpret_cast<uint16_t *>(buf.get()));
+  unpack(img, dst.get(), dstStride, numThreads);
+  return (dst);
+}
+
+const char * get_instruction_set()
+{
+  return (current_kernels().load(std::memory_order_relaxed)->name);
+}
+
+bool set_instruction_set(const char * name)
+{
+  const Kernels * k = find_kernels(name);
+  if (k) {
+    current_kernels().store(k, std::memory_order_relaxed);
+  }
+  return (k != nullptr);
+}
+}  // namespace unpack
+}  // namespace flir_spinnaker_common
@@ -0,0 +1,156 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "watchdog.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace flir_spinnaker_common
+{
+namespace chrono = std::chrono;
+
+// a stall is declared after this many frame intervals without a frame
+static const uint64_t MISSED_FRAMES = 5;
+static const uint64_t MIN_TIMEOUT = 50000000ULL;  // 50ms
+// time for the first frame after start or restart
+static const uint64_t STARTUP_TIMEOUT = 1000000000ULL;
+// the backoff doubles the timeout, up to 64 times or MAX_BACKOFF_TIMEOUT
+static const int MAX_BACKOFF_SHIFT = 6;
+static const uint64_t MAX_BACKOFF_TIMEOUT = 30000000000ULL;
+// frames needed before the measured interval is trusted
+static const uint64_t MIN_FRAMES = 3;
+
+// same clock as the frame time stamps
+static uint64_t get_time()
+{
+  return (chrono::duration_cast<chrono::nanoseconds>(
+            chrono::high_resolution_clock::now().time_since_epoch())
+            .count());
+}
+
+Watchdog::~Watchdog() { stop(); }
+
+void Watchdog::start(
+  uint64_t expectedInterval, uint64_t maxTimeout, const Restarter & r)
+{
+  stop();
+  expectedInterval_ = expectedInterval;
+  maxTimeout_ = maxTimeout;
+  restarter_ = r;
+  stallTime_ = 0;
+  numRestarts_ = 0;
+  numRecoveries_ = 0;
+  lastRecoveryTime_ = 0;
+  maxRecoveryTime_ = 0;
+  keepRunning_ = true;
+  thread_ = std::thread(&Watchdog::run, this);
+}
+
+void Watchdog::stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+uint64_t Watchdog::get_timeout(
+  uint64_t interval, uint64_t maxTimeout, bool haveFrames,
+  int numFailedRestarts)
+{
+  uint64_t t = maxTimeout;
+  if (interval != 0) {
+    t = std::max(MISSED_FRAMES * interval, MIN_TIMEOUT);
+  }
+  if (!haveFrames) {
+    t = std::max(t, STARTUP_TIMEOUT);
+  }
+  t = std::min(t, maxTimeout);
+  return (std::min(
+    t << std::min(numFailedRestarts, MAX_BACKOFF_SHIFT),
+    std::max(maxTimeout, MAX_BACKOFF_TIMEOUT)));
+}
+
+void Watchdog::run()
+{
+  const uint64_t startTime = get_time();
+  uint64_t restartTime = 0;  // of the last restart
+  int numFailed = 0;  // restarts since frames last arrived
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (keepRunning_) {
+    const uint64_t lastFrame = statistics_.getLastTime();
+    if (restartTime != 0 && lastFrame > restartTime) {
+      numFailed = 0;  // the frames are back
+      restartTime = 0;
+    }
+    const uint64_t since = std::max(startTime, restartTime);
+    // the median is not thrown off by the stalls themselves
+    Driver::Statistics s;
+    statistics_.getSnapshot(&s);
+    uint64_t interval = expectedInterval_;
+    if (s.numFrames >= MIN_FRAMES) {
+      interval =
+        std::max(interval, static_cast<uint64_t>(s.intervalP50 * 1e9));
+    }
+    const uint64_t deadline =
+      std::max(lastFrame, since) +
+      get_timeout(interval, maxTimeout_, lastFrame > since, numFailed);
+    const uint64_t now = get_time();
+    if (now < deadline) {
+      // wake up early to tighten the deadline once frames arrive
+      const uint64_t maxWait = get_timeout(interval, maxTimeout_, true, 0);
+      cv_.wait_for(
+        lock, chrono::nanoseconds(std::min(deadline - now, maxWait)));
+      continue;
+    }
+    uint64_t noStall = 0;  // keep the time of the first detection
+    stallTime_.compare_exchange_strong(noStall, now);
+    numRestarts_++;
+    lock.unlock();
+    restarter_();
+    lock.lock();
+    restartTime = get_time();
+    numFailed++;
+  }
+}
+
+void Watchdog::recovered(uint64_t t)
+{
+  uint64_t stall = stallTime_.load(std::memory_order_relaxed);
+  if (stall == 0 || !stallTime_.compare_exchange_strong(stall, 0)) {
+    return;
+  }
+  const uint64_t dt = t > stall ? t - stall : 0;
+  lastRecoveryTime_ = dt;
+  numRecoveries_++;
+  uint64_t maxTime = maxRecoveryTime_;
+  while (dt > maxTime && !maxRecoveryTime_.compare_exchange_weak(maxTime, dt)) {
+  }
+}
+
+void Watchdog::getStatistics(Driver::Statistics * s) const
+{
+  s->numRestarts = numRestarts_;
+  s->numRecoveries = numRecoveries_;
+  s->lastRecoveryTime = lastRecoveryTime_ * 1e-9;
+  s->maxRecoveryTime = maxRecoveryTime_ * 1e-9;
+}
+}  // namespace flir_spinnaker_common
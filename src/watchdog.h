@@ -0,0 +1,88 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <flir_spinnaker_common/driver.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "frame_statistics.h"
+
+namespace flir_spinnaker_common
+{
+//
+// Restarts the stream when frames stop arriving. The deadline for the
+// next frame is a few frame intervals, from the expected frame rate or
+// the intervals seen so far, capped by the acquisition timeout. The
+// thread sleeps until the deadline of the last frame received, so
+// there is no polling and no per-frame work beyond frameArrived().
+// Restarts that do not bring the frames back are repeated with
+// exponential backoff.
+//
+class Watchdog
+{
+public:
+  // does the restart, must be serialized with starting and stopping
+  typedef std::function<void()> Restarter;
+
+  explicit Watchdog(const FrameStatistics & stats) : statistics_(stats) {}
+  ~Watchdog();
+  // times in nsec, expectedInterval = 0: frame rate not known
+  void start(
+    uint64_t expectedInterval, uint64_t maxTimeout, const Restarter & r);
+  void stop();
+  // called for every frame on the acquisition thread
+  void frameArrived(uint64_t t)
+  {
+    if (stallTime_.load(std::memory_order_relaxed) != 0) {
+      recovered(t);
+    }
+  }
+  // fills in the restart fields of the statistics
+  void getStatistics(Driver::Statistics * s) const;
+  // Deadline for the next frame. Times in nsec, interval = 0: unknown.
+  static uint64_t get_timeout(
+    uint64_t interval, uint64_t maxTimeout, bool haveFrames,
+    int numFailedRestarts);
+
+private:
+  void run();
+  void recovered(uint64_t t);
+  // ----- variables --
+  const FrameStatistics & statistics_;
+  uint64_t expectedInterval_{0};
+  uint64_t maxTimeout_{0};
+  Restarter restarter_;
+  bool keepRunning_{false};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  std::atomic<uint64_t> stallTime_{0};  // detection of the current stall
+  std::atomic<uint64_t> numRestarts_{0};
+  std::atomic<uint64_t> numRecoveries_{0};
+  std::atomic<uint64_t> lastRecoveryTime_{0};
+  std::atomic<uint64_t> maxRecoveryTime_{0};
+};
+}  // namespace flir_spinnaker_common
+
+#endif  // WATCHDOG_H_
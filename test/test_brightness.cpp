@@ -0,0 +1,188 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <flir_spinnaker_common/pixel_format.h>
+#include <flir_spinnaker_common/unpack.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "brightness.h"
+
+using flir_spinnaker_common::brightness::compute_mean;
+using flir_spinnaker_common::brightness::compute_mean_scalar;
+using flir_spinnaker_common::brightness::get_instruction_set;
+using flir_spinnaker_common::brightness::set_instruction_set;
+namespace pixel_format = flir_spinnaker_common::pixel_format;
+namespace unpack = flir_spinnaker_common::unpack;
+
+static const char * const INSTRUCTION_SETS[] = {"avx2", "sse2", "scalar"};
+
+// the instruction set picked at startup is restored after each test
+class BrightnessTest : public ::testing::Test
+{
+protected:
+  void SetUp() override { default_ = get_instruction_set(); }
+  void TearDown() override { set_instruction_set(default_.c_str()); }
+  std::string default_;
+};
+
+// random rows, the padding between them is set to 0xFF such that
+// reading past the end of a row shows up in the mean
+static std::vector<uint8_t> make_image(
+  pixel_format::PixelFormat pf, size_t w, size_t h, size_t * stride)
+{
+  const size_t rowBytes =
+    (w * pixel_format::get_traits(pf).bitsPerPixel + 7) / 8;
+  *stride = rowBytes + 13;
+  std::vector<uint8_t> img(*stride * h, 0xFF);
+  std::mt19937 gen(static_cast<unsigned int>(pf * 1000 + w));
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (size_t y = 0; y < h; y++) {
+    for (size_t x = 0; x < rowBytes; x++) {
+      img[y * *stride + x] = static_cast<uint8_t>(dist(gen));
+    }
+  }
+  return (img);
+}
+
+TEST_F(BrightnessTest, simd_matches_scalar)
+{
+  const size_t widths[] = {1, 3, 4, 7, 15, 16, 17, 31, 33, 65, 257, 1001};
+  const int skips[] = {0, 1, 2, 3, 32};
+  const size_t h = 37;
+  for (const char * isa : INSTRUCTION_SETS) {
+    if (!set_instruction_set(isa)) {
+      std::cout << "instruction set " << isa << " not supported, skipped"
+                << std::endl;
+      continue;
+    }
+    ASSERT_EQ(std::string(isa), get_instruction_set());
+    for (int f = 1; f < pixel_format::NUM_PIXEL_FORMATS; f++) {
+      const auto pf = static_cast<pixel_format::PixelFormat>(f);
+      for (const size_t w : widths) {
+        size_t stride;
+        const std::vector<uint8_t> img = make_image(pf, w, h, &stride);
+        for (const int skip : skips) {
+          const double ref =
+            compute_mean_scalar(pf, img.data(), w, h, stride, skip);
+          EXPECT_GE(ref, 0) << pixel_format::to_string(pf);
+          EXPECT_DOUBLE_EQ(
+            ref, compute_mean(pf, img.data(), w, h, stride, skip))
+            << isa << " " << pixel_format::to_string(pf) << " width " << w
+            << " skip " << skip;
+        }
+      }
+    }
+  }
+}
+
+// only the pixels at the sample points contribute
+TEST_F(BrightnessTest, samples_every_skip_column)
+{
+  const size_t w = 101;
+  const size_t h = 37;
+  const int skip = 4;
+  for (const auto pf :
+       {pixel_format::Mono8, pixel_format::BayerRG8, pixel_format::Mono16,
+        pixel_format::RGB8, pixel_format::BayerGB16}) {
+    const pixel_format::Traits t = pixel_format::get_traits(pf);
+    const size_t bytesPerPixel = t.bitsPerPixel / 8;
+    // 2x2 blocks for bayer images
+    const size_t block = t.cfa != pixel_format::NO_CFA ? 2 : 1;
+    const size_t stride = w * bytesPerPixel + 5;
+    std::vector<uint8_t> img(stride * h, 0);
+    for (size_t y = 0; y < h; y++) {
+      for (size_t x = 0; x < w; x++) {
+        if (y % skip < block && x % skip < block) {
+          memset(&img[y * stride + x * bytesPerPixel], 100, bytesPerPixel);
+        }
+      }
+    }
+    const double expected = bytesPerPixel == 2 ? 0x6464 : 100;
+    EXPECT_DOUBLE_EQ(
+      expected, compute_mean(pf, img.data(), w, h, stride, skip))
+      << pixel_format::to_string(pf);
+  }
+}
+
+// the packed formats against the unpacked pixels
+TEST_F(BrightnessTest, packed_formats)
+{
+  const size_t w = 203;  // leaves an incomplete group
+  const size_t h = 41;
+  for (int f = 1; f < pixel_format::NUM_PIXEL_FORMATS; f++) {
+    const auto pf = static_cast<pixel_format::PixelFormat>(f);
+    if (!unpack::is_packed(pf)) {
+      continue;
+    }
+    const bool bayer = pixel_format::get_traits(pf).cfa != pixel_format::NO_CFA;
+    size_t stride;
+    const std::vector<uint8_t> img = make_image(pf, w, h, &stride);
+    std::vector<uint16_t> px(w * h);
+    ASSERT_TRUE(unpack::unpack(pf, img.data(), w, h, stride, px.data(), 2 * w));
+    // only complete groups are used
+    const size_t groupPixels =
+      pixel_format::get_traits(pf).bitDepth == 10 &&
+          pixel_format::get_traits(pf).packing == pixel_format::PACKED_LSB
+        ? 4
+        : 2;
+    const size_t usable = (w / groupPixels) * groupPixels;
+    for (const int skip : {1, 3, 32}) {
+      const size_t step = static_cast<size_t>(skip);
+      const size_t block = (bayer && step > 1) ? 2 : 1;
+      double sum = 0;
+      size_t cnt = 0;
+      for (size_t y = 0; y < h; y++) {
+        for (size_t x = 0; x < usable; x++) {
+          if (y % step < block && x % step < block) {
+            sum += px[y * w + x];
+            cnt++;
+          }
+        }
+      }
+      EXPECT_DOUBLE_EQ(
+        sum / cnt, compute_mean(pf, img.data(), w, h, stride, skip))
+        << pixel_format::to_string(pf) << " skip " << skip;
+    }
+  }
+}
+
+// long rows of 16 bit words overflow 32 bit lane sums if not flushed
+TEST_F(BrightnessTest, long_word_rows)
+{
+  const size_t w = 300001;
+  const std::vector<uint8_t> img(2 * w * 2, 0xFF);
+  for (const char * isa : INSTRUCTION_SETS) {
+    if (set_instruction_set(isa)) {
+      EXPECT_DOUBLE_EQ(
+        65535.0,
+        compute_mean(pixel_format::Mono16, img.data(), w, 2, 2 * w, 1))
+        << isa;
+    }
+  }
+}
+
+TEST_F(BrightnessTest, unsupported)
+{
+  const std::vector<uint8_t> img(64, 0);
+  EXPECT_LT(compute_mean(pixel_format::INVALID, img.data(), 8, 8, 8, 1), 0);
+  EXPECT_FALSE(set_instruction_set("mmx"));
+}
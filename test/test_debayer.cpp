@@ -0,0 +1,222 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <flir_spinnaker_common/debayer.h>
+#include <flir_spinnaker_common/pixel_format.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace debayer = flir_spinnaker_common::debayer;
+namespace pixel_format = flir_spinnaker_common::pixel_format;
+using pixel_format::PixelFormat;
+
+static const char * const INSTRUCTION_SETS[] = {
+  "avx2", "sse2", "neon", "scalar"};
+// all four phases of the color filter
+static const PixelFormat FORMATS_8[] = {
+  pixel_format::BayerRG8, pixel_format::BayerGR8, pixel_format::BayerGB8,
+  pixel_format::BayerBG8};
+static const PixelFormat FORMATS_16[] = {
+  pixel_format::BayerRG16, pixel_format::BayerGR16, pixel_format::BayerGB16,
+  pixel_format::BayerBG16};
+static const debayer::Method METHODS[] = {
+  debayer::BILINEAR, debayer::EDGE_AWARE};
+// odd sizes leave partial vectors at the end of the rows
+static const size_t WIDTH = 37;
+static const size_t HEIGHT = 21;
+
+// the instruction set picked at startup is restored after each test
+class DebayerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override { default_ = debayer::get_instruction_set(); }
+  void TearDown() override { debayer::set_instruction_set(default_.c_str()); }
+  // runs f once for every instruction set the CPU supports
+  void forAllInstructionSets(const std::function<void(const char *)> & f)
+  {
+    for (const char * isa : INSTRUCTION_SETS) {
+      if (debayer::set_instruction_set(isa)) {
+        f(isa);
+      }
+    }
+  }
+  std::string default_;
+};
+
+// 16 bit RGB output of an 8 or 16 bit Bayer image given as values
+static std::vector<uint16_t> run_debayer(
+  PixelFormat pf, const std::vector<uint16_t> & raw, debayer::Method m)
+{
+  const bool is16 = pixel_format::get_traits(pf).bitDepth > 8;
+  std::vector<uint8_t> src(WIDTH * HEIGHT * (is16 ? 2 : 1));
+  for (size_t i = 0; i < raw.size(); i++) {
+    if (is16) {
+      reinterpret_cast<uint16_t *>(src.data())[i] = raw[i];
+    } else {
+      src[i] = static_cast<uint8_t>(raw[i]);
+    }
+  }
+  std::vector<uint16_t> rgb(3 * WIDTH * HEIGHT);
+  EXPECT_TRUE(debayer::debayer(
+    pf, src.data(), WIDTH, HEIGHT, src.size() / HEIGHT, rgb.data(),
+    3 * WIDTH * sizeof(uint16_t), debayer::RGB16, m, 1));
+  // undo the scaling to 16 bit
+  const int shift = 16 - pixel_format::get_traits(pf).bitDepth;
+  for (auto & v : rgb) {
+    v = static_cast<uint16_t>(v >> shift);
+  }
+  return (rgb);
+}
+
+static std::vector<uint16_t> random_image(int maxVal, unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(0, maxVal);
+  std::vector<uint16_t> raw(WIDTH * HEIGHT);
+  for (auto & v : raw) {
+    v = static_cast<uint16_t>(dist(gen));
+  }
+  return (raw);
+}
+
+// color (0: red, 1: green, 2: blue) at (x, y)
+static int get_color(PixelFormat pf, long x, long y)
+{
+  const pixel_format::ColorFilter cfa = pixel_format::get_traits(pf).cfa;
+  const int rx = (cfa == pixel_format::CFA_GR || cfa == pixel_format::CFA_BG);
+  const int ry = (cfa == pixel_format::CFA_GB || cfa == pixel_format::CFA_BG);
+  const bool redRow = (y & 1) == ry;
+  if (((x & 1) == rx) == redRow) {
+    return (redRow ? 0 : 2);
+  }
+  return (1);
+}
+
+static long mirror(long i, long n)
+{
+  return (i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i));
+}
+
+// textbook bilinear interpolation, mirrored at the image border
+static std::vector<uint16_t> reference_bilinear(
+  PixelFormat pf, const std::vector<uint16_t> & raw)
+{
+  const long w = WIDTH;
+  const long h = HEIGHT;
+  std::vector<uint16_t> rgb(3 * w * h);
+  for (long y = 0; y < h; y++) {
+    for (long x = 0; x < w; x++) {
+      for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        int n = 0;
+        for (long dy = -1; dy <= 1; dy++) {
+          for (long dx = -1; dx <= 1; dx++) {
+            // the site itself if it has the color, else its neighbors
+            const bool own = get_color(pf, x, y) == c;
+            if (
+              (own && (dx != 0 || dy != 0)) ||
+              get_color(pf, x + dx, y + dy) != c) {
+              continue;
+            }
+            sum += raw[mirror(y + dy, h) * w + mirror(x + dx, w)];
+            n++;
+          }
+        }
+        rgb[3 * (y * w + x) + c] = static_cast<uint16_t>((sum + n / 2) / n);
+      }
+    }
+  }
+  return (rgb);
+}
+
+TEST_F(DebayerTest, constant_field)
+{
+  forAllInstructionSets([](const char * isa) {
+    for (const PixelFormat pf : FORMATS_16) {
+      for (const debayer::Method m : METHODS) {
+        const std::vector<uint16_t> raw(WIDTH * HEIGHT, 1234);
+        for (const uint16_t v : run_debayer(pf, raw, m)) {
+          ASSERT_EQ(1234, v) << isa << " " << pixel_format::to_string(pf)
+                             << " method " << m;
+        }
+      }
+    }
+  });
+}
+
+// a linear ramp is reproduced exactly away from the border
+TEST_F(DebayerTest, ramp)
+{
+  forAllInstructionSets([](const char * isa) {
+    for (const PixelFormat pf : FORMATS_16) {
+      for (const debayer::Method m : METHODS) {
+        for (const bool horizontal : {true, false}) {
+          std::vector<uint16_t> raw(WIDTH * HEIGHT);
+          for (size_t y = 0; y < HEIGHT; y++) {
+            for (size_t x = 0; x < WIDTH; x++) {
+              raw[y * WIDTH + x] =
+                static_cast<uint16_t>(100 + 17 * (horizontal ? x : y));
+            }
+          }
+          const std::vector<uint16_t> rgb = run_debayer(pf, raw, m);
+          for (size_t y = 2; y < HEIGHT - 2; y++) {
+            for (size_t x = 2; x < WIDTH - 2; x++) {
+              for (int c = 0; c < 3; c++) {
+                ASSERT_EQ(raw[y * WIDTH + x], rgb[3 * (y * WIDTH + x) + c])
+                  << isa << " " << pixel_format::to_string(pf) << " method "
+                  << m << " at " << x << "," << y << " color " << c;
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+// covers the mirrored border rows and columns
+TEST_F(DebayerTest, bilinear_matches_reference)
+{
+  forAllInstructionSets([](const char * isa) {
+    for (const PixelFormat pf : FORMATS_8) {
+      const std::vector<uint16_t> raw = random_image(255, pf);
+      EXPECT_EQ(
+        reference_bilinear(pf, raw), run_debayer(pf, raw, debayer::BILINEAR))
+        << isa << " " << pixel_format::to_string(pf);
+    }
+  });
+}
+
+TEST_F(DebayerTest, simd_matches_scalar)
+{
+  for (const PixelFormat pf : FORMATS_16) {
+    for (const debayer::Method m : METHODS) {
+      const std::vector<uint16_t> raw = random_image(65535, pf);
+      ASSERT_TRUE(debayer::set_instruction_set("scalar"));
+      const std::vector<uint16_t> ref = run_debayer(pf, raw, m);
+      forAllInstructionSets([&](const char * isa) {
+        EXPECT_EQ(ref, run_debayer(pf, raw, m))
+          << isa << " " << pixel_format::to_string(pf) << " method " << m;
+      });
+    }
+  }
+}
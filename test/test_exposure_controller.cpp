@@ -0,0 +1,207 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <flir_spinnaker_common/driver.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "exposure_controller.h"
+
+using flir_spinnaker_common::Driver;
+using flir_spinnaker_common::ExposureController;
+using flir_spinnaker_common::ImageConstPtr;
+
+// brightness of a scene that is linear in exposure time and gain
+static int16_t scene_brightness(double level, double et, double gain)
+{
+  const double b = level * et * std::pow(10.0, gain / 20.0);
+  return (static_cast<int16_t>(std::min(std::round(b), 255.0)));
+}
+
+// Runs the control law for numFrames. The camera applies new settings
+// with a delay of lag frames. Returns the brightness of each frame.
+static std::vector<int16_t> simulate(
+  const Driver::ExposureControlConfig & config, double level, int lag,
+  int numFrames)
+{
+  double et = 5000;
+  double gain = 0;
+  ExposureController controller(config, et, gain);
+  // frame at which they take effect, et, gain
+  std::deque<std::tuple<int, double, double>> pending;
+  std::vector<int16_t> brightness;
+  for (int i = 0; i < numFrames; i++) {
+    ExposureController::Sample s;
+    s.brightness = scene_brightness(level, et, gain);
+    s.exposureTime = et;
+    s.gain = gain;
+    s.maxExposureTime = 30000;
+    brightness.push_back(s.brightness);
+    double newEt, newGain;
+    if (controller.update(s, 1, &newEt, &newGain)) {
+      pending.emplace_back(i + 1 + lag, newEt, newGain);
+    }
+    while (!pending.empty() && std::get<0>(pending.front()) <= i + 1) {
+      et = std::get<1>(pending.front());
+      gain = std::get<2>(pending.front());
+      pending.pop_front();
+    }
+  }
+  return (brightness);
+}
+
+// number of times the brightness crosses from one side of the target
+// band to the other
+static int count_crossings(
+  const std::vector<int16_t> & b, double target, double tolerance)
+{
+  int crossings = 0;
+  int side = 0;
+  for (const int16_t v : b) {
+    const int s =
+      v > target + tolerance ? 1 : (v < target - tolerance ? -1 : 0);
+    if (s != 0 && side != 0 && s != side) {
+      crossings++;
+    }
+    side = s != 0 ? s : side;
+  }
+  return (crossings);
+}
+
+TEST(ExposureControllerTest, converges_without_oscillation)
+{
+  Driver::ExposureControlConfig config;
+  config.tolerance = 4;
+  // dark scenes need gain on top of the maximum exposure time,
+  // bright ones start out saturated
+  for (const double level : {0.001, 0.005, 0.02, 0.2}) {
+    for (const double target : {40.0, 128.0, 200.0}) {
+      config.targetBrightness = target;
+      for (const int lag : {0, 1, 3}) {
+        const std::vector<int16_t> b = simulate(config, level, lag, 100);
+        // the last 50 frames are within the target band
+        for (size_t i = b.size() - 50; i < b.size(); i++) {
+          ASSERT_LE(std::abs(b[i] - target), config.tolerance + 1)
+            << "level " << level << " target " << target << " lag " << lag
+            << " frame " << i;
+        }
+        EXPECT_LE(count_crossings(b, target, config.tolerance), 1)
+          << "level " << level << " target " << target << " lag " << lag;
+      }
+    }
+  }
+}
+
+// frames that arrive between two updates count towards settling
+TEST(ExposureControllerTest, settling_counts_frames)
+{
+  Driver::ExposureControlConfig config;
+  ExposureController controller(config, 5000, 0);
+  ExposureController::Sample s;
+  s.brightness = 32;
+  s.exposureTime = 5000;
+  double et, gain;
+  ASSERT_TRUE(controller.update(s, 1, &et, &gain));
+  // still exposed with the old settings
+  s.brightness = 64;
+  EXPECT_FALSE(controller.update(s, 1, &et, &gain));
+  // no new settings after many frames, go on without them
+  EXPECT_TRUE(controller.update(s, 10, &et, &gain));
+}
+
+// brightness, exposure time and gain of a frame
+struct Frame
+{
+  int16_t brightness;
+  uint32_t exposureTime;
+  float gain;
+};
+
+// true once the last numFrames are on target with the same exposure
+static bool is_settled(
+  const std::vector<Frame> & f, double target, double tolerance,
+  size_t numFrames)
+{
+  if (f.size() < numFrames) {
+    return (false);
+  }
+  for (size_t i = f.size() - numFrames; i < f.size(); i++) {
+    if (
+      std::abs(f[i].brightness - target) > tolerance ||
+      f[i].exposureTime != f.back().exposureTime ||
+      f[i].gain != f.back().gain) {
+      return (false);
+    }
+  }
+  return (true);
+}
+
+TEST(ExposureControllerTest, synthetic_camera)
+{
+  // four control periods at the default maximum update rate
+  const size_t numSettledFrames = 20;
+  for (const double target : {60.0, 180.0}) {
+    Driver driver;
+    Driver::SyntheticCameraConfig cc;
+    cc.pixelFormat = "Mono8";
+    cc.width = 160;
+    cc.height = 120;
+    cc.frameRate = 100;
+    ASSERT_TRUE(driver.initSyntheticCamera(cc));
+    Driver::ExposureControlConfig ec;
+    ec.enabled = true;
+    ec.targetBrightness = target;
+    driver.setExposureControl(ec);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Frame> frames;
+    bool settled = false;
+    ASSERT_TRUE(driver.startCamera([&](const ImageConstPtr & img) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!settled) {
+        frames.push_back({img->brightness_, img->exposureTime_, img->gain_});
+        settled = is_settled(
+          frames, target, ec.tolerance + 2, numSettledFrames);
+        if (settled) {
+          cv.notify_all();
+        }
+      }
+    }));
+    {
+      // generous, a loaded machine may deliver the frames slowly
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait_for(lock, std::chrono::seconds(30), [&] { return (settled); });
+    }
+    driver.stopCamera();
+    driver.deInitCamera();
+    ASSERT_TRUE(settled) << "target " << target << " not reached after "
+                         << frames.size() << " frames";
+    std::vector<int16_t> b;
+    for (const Frame & f : frames) {
+      b.push_back(f.brightness);
+    }
+    EXPECT_LE(count_crossings(b, target, ec.tolerance), 1)
+      << "target " << target;
+  }
+}
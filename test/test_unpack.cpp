@@ -0,0 +1,185 @@
+// -*-c++-*--------------------------------------------------------------------
+// Copyright 2020 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <flir_spinnaker_common/pixel_format.h>
+#include <flir_spinnaker_common/unpack.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace unpack = flir_spinnaker_common::unpack;
+namespace pixel_format = flir_spinnaker_common::pixel_format;
+using pixel_format::PixelFormat;
+
+static const char * const INSTRUCTION_SETS[] = {"ssse3", "scalar"};
+static const PixelFormat FORMATS[] = {
+  pixel_format::Mono10p,         pixel_format::Mono10Packed,
+  pixel_format::Mono12p,         pixel_format::Mono12Packed,
+  pixel_format::BayerRG10p,      pixel_format::BayerRG10Packed,
+  pixel_format::BayerRG12p,      pixel_format::BayerRG12Packed};
+// odd widths leave partial vectors and half filled groups at the end
+static const size_t WIDTHS[] = {1, 3, 5, 7, 9, 15, 17, 33, 127, 641};
+// extra bytes at the end of each source row
+static const size_t PADDINGS[] = {0, 1, 3, 13};
+// enough rows to split the image across threads
+static const size_t HEIGHT = 67;
+static const uint16_t SENTINEL = 0xBEEF;
+
+// the instruction set picked at startup is restored after each test
+class UnpackTest : public ::testing::Test
+{
+protected:
+  void SetUp() override { default_ = unpack::get_instruction_set(); }
+  void TearDown() override { unpack::set_instruction_set(default_.c_str()); }
+  // runs f once for every instruction set the CPU supports
+  void forAllInstructionSets(const std::function<void(const char *)> & f)
+  {
+    for (const char * isa : INSTRUCTION_SETS) {
+      if (unpack::set_instruction_set(isa)) {
+        f(isa);
+      }
+    }
+  }
+  std::string default_;
+};
+
+static bool is_gige(PixelFormat pf)
+{
+  return (pixel_format::get_traits(pf).packing == pixel_format::PACKED_GIGE);
+}
+
+static size_t packed_row_bytes(PixelFormat pf, size_t w)
+{
+  // GigE packing uses 3 bytes per 2 pixels for 10 bit as well
+  const size_t bits = is_gige(pf) ? 12 : pixel_format::get_traits(pf).bitDepth;
+  return ((w * bits + 7) / 8);
+}
+
+// packs one row of values, written from the GenICam layout descriptions
+static void pack_row(
+  PixelFormat pf, const uint16_t * v, size_t w, uint8_t * row)
+{
+  const int bits = pixel_format::get_traits(pf).bitDepth;
+  if (!is_gige(pf)) {
+    // bit stream, least significant bit first
+    for (size_t j = 0; j < w; j++) {
+      for (int b = 0; b < bits; b++) {
+        const size_t bit = j * bits + b;
+        const int mask = 1 << (bit % 8);
+        row[bit / 8] = static_cast<uint8_t>(
+          ((v[j] >> b) & 1) ? (row[bit / 8] | mask) : (row[bit / 8] & ~mask));
+      }
+    }
+    return;
+  }
+  // 2 pixels in 3 bytes: the high bits of each pixel in bytes 0 and 2,
+  // the low bits share byte 1 (even pixel in the low nibble)
+  const int low = bits - 8;
+  for (size_t j = 0; j < w; j++) {
+    uint8_t * g = row + (j / 2) * 3;
+    const uint8_t lowBits = static_cast<uint8_t>(v[j] & ((1 << low) - 1));
+    if (j & 1) {
+      g[2] = static_cast<uint8_t>(v[j] >> low);
+      g[1] = static_cast<uint8_t>((g[1] & 0x0F) | (lowBits << 4));
+    } else {
+      g[0] = static_cast<uint8_t>(v[j] >> low);
+      g[1] = static_cast<uint8_t>((g[1] & 0xF0) | lowBits);
+    }
+  }
+}
+
+// Packs random values into rows with random padding, unpacks them into
+// rows with one spare value and checks values and the spare.
+static void check_unpack(
+  PixelFormat pf, size_t w, size_t padding, int numThreads, unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  const int maxVal = (1 << pixel_format::get_traits(pf).bitDepth) - 1;
+  std::uniform_int_distribution<int> dist(0, maxVal);
+  std::uniform_int_distribution<int> byteDist(0, 255);
+  const size_t srcStride = packed_row_bytes(pf, w) + padding;
+  std::vector<uint16_t> values(w * HEIGHT);
+  std::vector<uint8_t> src(srcStride * HEIGHT);
+  for (auto & b : src) {
+    b = static_cast<uint8_t>(byteDist(gen));
+  }
+  for (size_t y = 0; y < HEIGHT; y++) {
+    for (size_t x = 0; x < w; x++) {
+      values[y * w + x] = static_cast<uint16_t>(dist(gen));
+    }
+    pack_row(pf, &values[y * w], w, &src[y * srcStride]);
+  }
+  const size_t dstWidth = w + 1;
+  std::vector<uint16_t> dst(dstWidth * HEIGHT, SENTINEL);
+  ASSERT_TRUE(unpack::unpack(
+    pf, src.data(), w, HEIGHT, srcStride, dst.data(),
+    dstWidth * sizeof(uint16_t), numThreads));
+  for (size_t y = 0; y < HEIGHT; y++) {
+    for (size_t x = 0; x < w; x++) {
+      ASSERT_EQ(dst[y * dstWidth + x], values[y * w + x])
+        << "x: " << x << " y: " << y;
+    }
+    ASSERT_EQ(dst[y * dstWidth + w], SENTINEL) << "row " << y;
+  }
+}
+
+TEST_F(UnpackTest, all_formats)
+{
+  forAllInstructionSets([](const char * isa) {
+    unsigned int seed = 1;
+    for (const PixelFormat pf : FORMATS) {
+      for (const size_t w : WIDTHS) {
+        for (const size_t padding : PADDINGS) {
+          SCOPED_TRACE(
+            std::string(isa) + " " + pixel_format::to_string(pf) +
+            " width " + std::to_string(w) + " padding " +
+            std::to_string(padding));
+          check_unpack(pf, w, padding, 1, seed++);
+        }
+      }
+    }
+  });
+}
+
+TEST_F(UnpackTest, multithreaded)
+{
+  forAllInstructionSets([](const char * isa) {
+    for (const PixelFormat pf : FORMATS) {
+      SCOPED_TRACE(std::string(isa) + " " + pixel_format::to_string(pf));
+      check_unpack(pf, 641, 3, 0, 42);
+    }
+  });
+}
+
+TEST_F(UnpackTest, instruction_set_override)
+{
+  EXPECT_FALSE(unpack::set_instruction_set("no_such_isa"));
+  EXPECT_EQ(std::string(unpack::get_instruction_set()), default_);
+  ASSERT_TRUE(unpack::set_instruction_set("scalar"));
+  EXPECT_EQ(std::string(unpack::get_instruction_set()), "scalar");
+}
+
+TEST_F(UnpackTest, unsupported_format)
+{
+  uint8_t src[16] = {0};
+  uint16_t dst[8] = {0};
+  EXPECT_FALSE(unpack::is_packed(pixel_format::Mono8));
+  EXPECT_FALSE(
+    unpack::unpack(pixel_format::Mono16, src, 4, 1, 8, dst, sizeof(dst)));
+}